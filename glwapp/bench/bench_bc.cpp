@@ -0,0 +1,228 @@
+// Block compression benchmark : encode time per format against the raw RGBA8 upload, sizes and round trip error.
+// Usage : bench_bc [width height [iterations]]
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <vector>
+#include "../windowHelper.h"
+#include <libglw/GLWrapper.h>
+#include <libglw/BlockCompressor.h>
+
+using Compressor = gl::BlockCompressor;
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+    double elapsedMs(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+    /// Gradients with some noise, the kind of content generated at runtime
+    std::vector<unsigned char> makeImage(glm::ivec2 size)
+    {
+        std::vector<unsigned char> image(static_cast<size_t>(size.x) * size.y * 4);
+        std::mt19937 random(42);
+        std::uniform_int_distribution<int> noise(-8, 8);
+        for (int y = 0; y < size.y; ++y)
+            for (int x = 0; x < size.x; ++x)
+            {
+                unsigned char* p = &image[(static_cast<size_t>(y) * size.x + x) * 4];
+                const float wave = std::sin(x * 0.05f) * std::cos(y * 0.03f);
+                const int values[4] = { x * 255 / size.x + noise(random), y * 255 / size.y + noise(random), static_cast<int>(128 + 100 * wave) + noise(random), (x + y) * 255 / (size.x + size.y) };
+                for (int c = 0; c < 4; ++c)
+                    p[c] = static_cast<unsigned char>(std::min(std::max(values[c], 0), 255));
+            }
+        return image;
+    }
+    void decodeColor(const unsigned char* block, int rgb[16][3])
+    {
+        const int color0 = block[0] | block[1] << 8, color1 = block[2] | block[3] << 8;
+        int palette[4][3];
+        const int packed[2] = { color0, color1 };
+        for (int i = 0; i < 2; ++i)
+        {
+            const int r = packed[i] >> 11 & 31, g = packed[i] >> 5 & 63, b = packed[i] & 31;
+            palette[i][0] = r << 3 | r >> 2;
+            palette[i][1] = g << 2 | g >> 4;
+            palette[i][2] = b << 3 | b >> 2;
+        }
+        for (int c = 0; c < 3; ++c)
+            if (color0 > color1)
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            else
+            {
+                palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+                palette[3][c] = 0;
+            }
+        const unsigned indices = block[4] | block[5] << 8 | block[6] << 16 | static_cast<unsigned>(block[7]) << 24;
+        for (int i = 0; i < 16; ++i)
+            for (int c = 0; c < 3; ++c)
+                rgb[i][c] = palette[indices >> (2 * i) & 3][c];
+    }
+    void decodeChannel(const unsigned char* block, int values[16])
+    {
+        const int a0 = block[0], a1 = block[1];
+        int palette[8] = { a0, a1 };
+        if (a0 > a1)
+            for (int i = 1; i < 7; ++i)
+                palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+        else
+        {
+            for (int i = 1; i < 5; ++i)
+                palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+        unsigned long long indices = 0;
+        for (int i = 0; i < 6; ++i)
+            indices |= static_cast<unsigned long long>(block[2 + i]) << (8 * i);
+        for (int i = 0; i < 16; ++i)
+            values[i] = palette[indices >> (3 * i) & 7];
+    }
+    /// Root mean square error of some blocks decoded back, on the channels kept by the format
+    double roundTrip(Compressor::Format format, const std::vector<unsigned char>& blocks, const std::vector<unsigned char>& image, glm::ivec2 size)
+    {
+        const int blocksX = (size.x + 3) / 4, count = blocksX * ((size.y + 3) / 4);
+        const int samples = std::min(count, 256);
+        double error = 0;
+        long values = 0;
+        for (int s = 0; s < samples; ++s)
+        {
+            const int index = static_cast<int>(static_cast<long long>(s) * count / samples);
+            const unsigned char* block = &blocks[static_cast<size_t>(index) * Compressor::BlockBytes(format)];
+            int rgb[16][3], first[16], second[16];
+            // Channels compared : red, green, blue, alpha
+            int decoded[16][4];
+            bool used[4] = { false, false, false, false };
+            switch (format)
+            {
+            case Compressor::BC1:
+            case Compressor::BC3:
+                decodeColor(format == Compressor::BC3 ? block + 8 : block, rgb);
+                for (int i = 0; i < 16; ++i)
+                    std::copy(rgb[i], rgb[i] + 3, decoded[i]);
+                used[0] = used[1] = used[2] = true;
+                if (format == Compressor::BC3)
+                {
+                    decodeChannel(block, first);
+                    for (int i = 0; i < 16; ++i)
+                        decoded[i][3] = first[i];
+                    used[3] = true;
+                }
+                break;
+            case Compressor::BC4:
+            case Compressor::BC5:
+                decodeChannel(block, first);
+                for (int i = 0; i < 16; ++i)
+                    decoded[i][0] = first[i];
+                used[0] = true;
+                if (format == Compressor::BC5)
+                {
+                    decodeChannel(block + 8, second);
+                    for (int i = 0; i < 16; ++i)
+                        decoded[i][1] = second[i];
+                    used[1] = true;
+                }
+                break;
+            }
+            const int bx = index % blocksX, by = index / blocksX;
+            for (int i = 0; i < 16; ++i)
+            {
+                const int x = bx * 4 + i % 4, y = by * 4 + i / 4;
+                if (x >= size.x || y >= size.y)
+                    continue;
+                const unsigned char* source = &image[(static_cast<size_t>(y) * size.x + x) * 4];
+                for (int c = 0; c < 4; ++c)
+                    if (used[c])
+                    {
+                        const double difference = decoded[i][c] - source[c];
+                        error += difference * difference;
+                        ++values;
+                    }
+            }
+        }
+        return values ? std::sqrt(error / values) : 0.;
+    }
+    /// Mean time of an upload, the GPU included. The first one allocates the storage and isn't counted.
+    double uploadMs(const std::function<void()>& upload, int iterations)
+    {
+        upload();
+        glFinish();
+        const Clock::time_point start = Clock::now();
+        for (int i = 0; i < iterations; ++i)
+            upload();
+        glFinish();
+        return elapsedMs(start) / iterations;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    glm::ivec2 size(2048);
+    int iterations = 5;
+    if (argc > 2)
+        size = glm::ivec2(std::atoi(argv[1]), std::atoi(argv[2]));
+    if (argc > 3)
+        iterations = std::max(1, std::atoi(argv[3]));
+    if (size.x <= 0 || size.y <= 0)
+    {
+        std::fprintf(stderr, "usage : %s [width height [iterations]]\n", argv[0]);
+        return 2;
+    }
+
+    Window window;
+    glewExperimental = true;
+    glewInit();
+    gl::Object::SetAutoInstantiate(true);
+
+    const std::vector<unsigned char> image = makeImage(size);
+    const double pixels = static_cast<double>(size.x) * size.y;
+    Compressor compressor;
+    std::printf("%dx%d, %d iterations, encoder %s on %u threads\n\n", size.x, size.y, iterations, Compressor::InstructionSet(), compressor.threads());
+    std::printf("%-6s %10s %12s %10s %12s %7s %7s\n", "format", "encode ms", "Mpixels/s", "upload ms", "bytes", "ratio", "rmse");
+
+    const double rawBytes = pixels * 4;
+    {
+        gl::Texture texture;
+        texture.setFormat(GL_RGBA8);
+        const double upload = uploadMs([&] { texture.load(GL_RGBA, GL_UNSIGNED_BYTE, image.data(), glm::vec2(size)); }, iterations);
+        std::printf("%-6s %10s %12s %10.2f %12.0f %7.2f %7s\n", "RGBA8", "-", "-", upload, rawBytes, 1., "-");
+    }
+
+    const char* names[] = { "BC1", "BC3", "BC4", "BC5" };
+    const Compressor::Format formats[] = { Compressor::BC1, Compressor::BC3, Compressor::BC4, Compressor::BC5 };
+    // Range fit on this image stays well below it, a broken encoder doesn't
+    const double maxError = 16.;
+    int failures = 0;
+    for (int f = 0; f < 4; ++f)
+    {
+        const Compressor::Format format = formats[f];
+        std::vector<unsigned char> blocks(Compressor::CompressedSize(format, size));
+        compressor.compress(format, image.data(), size, 4, blocks.data());
+        const Clock::time_point start = Clock::now();
+        for (int i = 0; i < iterations; ++i)
+            compressor.compress(format, image.data(), size, 4, blocks.data());
+        const double encode = elapsedMs(start) / iterations;
+
+        gl::Texture texture;
+        glGetError();
+        const double upload = uploadMs([&] { texture.loadCompressed(Compressor::InternalFormat(format), blocks.data(), static_cast<GLsizei>(blocks.size()), size); }, iterations);
+        const bool uploaded = glGetError() == GL_NO_ERROR;
+
+        const double error = roundTrip(format, blocks, image, size);
+        if (error > maxError)
+            ++failures;
+        char uploadText[32];
+        std::snprintf(uploadText, sizeof(uploadText), uploaded ? "%.2f" : "n/a", upload);
+        std::printf("%-6s %10.2f %12.1f %10s %12zu %7.2f %7.2f%s\n", names[f], encode, pixels / encode / 1000., uploadText, blocks.size(), rawBytes / blocks.size(), error, error > maxError ? "  FAILED" : "");
+    }
+    gl::NamePools::Current().clear();
+    return failures ? 1 : 0;
+}
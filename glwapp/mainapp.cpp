@@ -85,6 +85,7 @@ int main(int argv, char** argc)
     //Init vars
     auto buffer = genVBO();
     auto program = genShaders();
+    auto modelmatUniform = program.uniformHandle<glm::mat4>("modelmat");
     glm::mat4 modelmat(1.f);
     //loop
     while (!winMain->isClosed())
@@ -92,11 +93,13 @@ int main(int argv, char** argc)
         modelmat = glm::rotate(modelmat,glm::radians(0.1f), glm::vec3(0,0,1));
         winMain->updateEvents();
         gl::ClearColor(glm::vec3(0.1f), 1.f);
-        program << gl::sl::use
-            << gl::UniformRef<glm::mat4>("modelmat", modelmat);
+        program.use();
+        modelmatUniform.set(modelmat);
         buffer->draw(GL_TRIANGLES);
         winMain->swapBuffers();
     }
+    buffer.reset();
+    gl::NamePools::Current().clear();
     winMain.reset();
     return 0;
 }
\ No newline at end of file
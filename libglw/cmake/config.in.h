@@ -1,4 +1,6 @@
 #  cmakedefine01 LIBGLW_WITH_STD_FILESYSTEM
 #if LIBGLW_WITH_STD_FILESYSTEM
 #   include <filesystem>
-#endif
\ No newline at end of file
+#endif
+#  cmakedefine01 LIBGLW_WITH_DSA
+#  cmakedefine01 LIBGLW_WITH_STATE_CHECK
@@ -0,0 +1,114 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "Shaders.h"
+
+namespace gl
+{
+	namespace sl
+	{
+		/**
+		 * @brief Compile and link programs without waiting for the driver
+		 *
+		 * submit starts compiling the stages of a program and links it at once, without querying any status : the driver queues the work.
+		 * With KHR_parallel_shader_compile, it runs on the driver threads (see setMaxThreads) while the application does something else,
+		 * and poll only ends the programs whose GL_COMPLETION_STATUS_KHR is set. Without the extension, poll waits for each program in turn.
+		 *
+		 * Each submit returns a Ticket, telling when the program is ready or why it failed :
+		 * ```cpp
+		 * gl::sl::AsyncCompiler compiler;
+		 * auto ticket = compiler.submit(program, {{gl::sl::Vertex, vert}, {gl::sl::Fragment, frag}});
+		 * while (compiler.pending())
+		 * {
+		 *     loadNextAsset();
+		 *     compiler.poll();
+		 * }
+		 * if (ticket->failed())
+		 *     std::cerr << ticket->error;
+		 * ```
+		 * Submitted programs must stay alive until their ticket is done. Every call must be done on the GL thread.
+		 */
+		class AsyncCompiler
+		{
+		public:
+			DECL_PTR(AsyncCompiler)
+			enum class State
+			{
+				Pending,
+				Ready,
+				Failed
+			};
+			/// Result of a submitted program
+			struct Status
+			{
+				State state = State::Pending;
+				/// Compile or link log when failed
+				std::string error;
+				bool done() const
+				{
+					return state != State::Pending;
+				}
+				bool ready() const
+				{
+					return state == State::Ready;
+				}
+				bool failed() const
+				{
+					return state == State::Failed;
+				}
+			};
+			using Ticket = std::shared_ptr<const Status>;
+
+			AsyncCompiler() = default;
+			AsyncCompiler(const AsyncCompiler&) = delete;
+			AsyncCompiler& operator=(const AsyncCompiler&) = delete;
+			/// Release the shaders of the programs still pending. Their tickets stay pending.
+			~AsyncCompiler();
+
+			/// True if the driver compiles in the background (KHR_parallel_shader_compile)
+			static bool Parallel();
+			/**
+			 * @brief Number of threads the driver may use to compile
+			 *
+			 * 0 compiles on the GL thread, 0xFFFFFFFF lets the driver choose (default).
+			 * @see [glMaxShaderCompilerThreadsKHR](https://registry.khronos.org/OpenGL/extensions/KHR/KHR_parallel_shader_compile.txt)
+			 */
+			static void SetMaxThreads(GLuint count);
+
+			/**
+			 * @brief Start compiling and linking a program
+			 *
+			 * @param name Name used in the error messages
+			 */
+			Ticket submit(Program& program, const std::vector<ShaderSource>& sources, const std::string& name = std::string());
+			/**
+			 * @brief End the programs the driver is done with
+			 *
+			 * Never blocks with KHR_parallel_shader_compile.
+			 * @return how many programs have been ended
+			 */
+			size_t poll();
+			/// End every program, waiting for the driver.
+			void finish();
+			/// Programs not ended yet
+			size_t pending() const
+			{
+				return m_jobs.size();
+			}
+		private:
+			struct Job
+			{
+				/// Reference to the submitted program
+				Program program;
+				std::vector<std::pair<TypeShader, GLuint>> shaders;
+				std::string name;
+				std::shared_ptr<Status> status;
+			};
+			/// Read the result of a job, and release its shaders
+			static void end(Job& job);
+
+			std::vector<Job> m_jobs;
+		};
+	}
+}
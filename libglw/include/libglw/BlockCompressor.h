@@ -0,0 +1,95 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "GLClass.h"
+
+namespace gl
+{
+	/**
+	 * @brief CPU encoder of block compressed textures (S3TC and RGTC)
+	 *
+	 * Images made at runtime can be compressed before the upload : BC1 takes 8 times less memory and bandwidth than RGBA8,
+	 * BC3 and BC5 4 times less. Each 4x4 block is encoded with its bounding box (range fit) : fast enough for loading screens,
+	 * below the quality of offline compressors.
+	 *
+	 * Block rows are shared by a pool of threads. The block math uses SSE2, and AVX2 when the library is built for it
+	 * (-mavx2, /arch:AVX2), with a plain C++ version for other processors.
+	 * ```cpp
+	 * gl::BlockCompressor compressor;
+	 * auto blocks = compressor.compress(gl::BlockCompressor::BC3, pixels, size);
+	 * texture.loadCompressed(gl::BlockCompressor::InternalFormat(gl::BlockCompressor::BC3), blocks.data(), static_cast<GLsizei>(blocks.size()), size);
+	 * ```
+	 */
+	class BlockCompressor
+	{
+	public:
+		DECL_PTR(BlockCompressor)
+		enum Format
+		{
+			/// RGB, 8 bytes per block
+			BC1,
+			/// RGBA, 16 bytes per block
+			BC3,
+			/// Red channel, 8 bytes per block
+			BC4,
+			/// Red and green channels, 16 bytes per block
+			BC5
+		};
+		/// @param threads Threads encoding the blocks, the calling one included. 0 for one per core.
+		explicit BlockCompressor(unsigned threads = 0);
+		BlockCompressor(const BlockCompressor&) = delete;
+		BlockCompressor& operator=(const BlockCompressor&) = delete;
+		~BlockCompressor();
+
+		/// Internal format to give to glCompressedTexImage2D
+		static GLenum InternalFormat(Format format);
+		/// Size in bytes of a 4x4 block
+		static GLsizei BlockBytes(Format format);
+		/// Size in bytes of a compressed image
+		static GLsizei CompressedSize(Format format, glm::ivec2 size);
+		/// Instruction set used by the encoder : "AVX2", "SSE2" or "C++"
+		static const char* InstructionSet();
+
+		/**
+		 * @brief Encode an image
+		 *
+		 * @param pixels Tightly packed rows of *channels* bytes per pixel (1 to 4). Missing channels read as 0, alpha as 255.
+		 * @param size Size in pixels, borders of partial blocks repeat the last row and column
+		 * @return CompressedSize(format, size) bytes
+		 */
+		std::vector<unsigned char> compress(Format format, const unsigned char* pixels, glm::ivec2 size, int channels = 4);
+		/// Encode into *output*, CompressedSize(format, size) bytes
+		void compress(Format format, const unsigned char* pixels, glm::ivec2 size, int channels, unsigned char* output);
+		unsigned threads() const
+		{
+			return static_cast<unsigned>(m_threads.size()) + 1;
+		}
+	private:
+		/// Rows of blocks shared by the threads
+		struct Batch
+		{
+			std::function<void(size_t)> job;
+			size_t rows = 0;
+			std::atomic<size_t> next{0};
+			std::atomic<size_t> finished{0};
+		};
+		/// Run *job* for each row, on every thread, and wait for the end
+		void run(size_t rows, std::function<void(size_t)> job);
+		/// Rows of the batch taken by the calling thread
+		void work(Batch& batch);
+		void worker();
+
+		std::vector<std::thread> m_threads;
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::condition_variable m_done;
+		std::shared_ptr<Batch> m_batch;
+		uint64_t m_generation = 0;
+		bool m_stop = false;
+	};
+}
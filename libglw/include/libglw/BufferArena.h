@@ -0,0 +1,279 @@
+#pragma once
+#include <map>
+#include <memory>
+#include <vector>
+#include "GLClass.h"
+
+namespace gl
+{
+	/**
+	 * @brief Sub-allocator of typed ranges in a few big buffers
+	 *
+	 * Instead of one OpenGL buffer per mesh, the arena allocates big buffers (pages) and carves ranges out of them.
+	 * Many meshes then share the same buffer name : less driver objects and less binds between draws.
+	 *
+	 * Free space of each page is kept in two lists, by offset (to merge neighbours on free) and by size (best fit on allocate).
+	 * A range is identified by its page and its offset in *MyStruct*, which can be used directly by draw calls :
+	 * ```cpp
+	 * auto range = arena.allocate(vertices.size());
+	 * arena.set(range, vertices);
+	 * arena.page(range.page).bind();
+	 * glDrawArrays(GL_TRIANGLES, range.first(), range.count);
+	 * ```
+	 * @param target Kind of buffer
+	 * @param MyStruct Type to work with
+	 */
+	template <GLenum target, typename MyStruct>
+	class BufferArena
+	{
+	public:
+		DECL_PTR(BufferArena)
+		/// Range allocated in the arena
+		struct Range
+		{
+			/// Index of the page (see BufferArena::page)
+			GLuint page = InvalidPage;
+			/// Offset of the range in the page, in *MyStruct*
+			GLsizeiptr offset = 0;
+			/// Size of the range, in *MyStruct*
+			GLsizeiptr count = 0;
+
+			bool valid() const
+			{
+				return page != InvalidPage;
+			}
+			/// First element, to use as *first* in glDrawArrays or as base vertex in glDrawElementsBaseVertex
+			GLint first() const
+			{
+				return static_cast<GLint>(offset);
+			}
+			/// Offset in bytes, to use as indices pointer in glDrawElements or in glBindBufferRange
+			GLintptr byteOffset() const
+			{
+				return offset * sizeof(MyStruct);
+			}
+		};
+		constexpr static GLuint InvalidPage = ~0u;
+		/// Buffer type of the pages
+		using BufferBase = Buffer<target, MyStruct>;
+
+		/**
+		 * @param page_size Size of each page in *MyStruct*. Bigger allocations get a page of their own.
+		 * @param usage Usage of the pages
+		 */
+		BufferArena(GLsizeiptr page_size, GLenum usage = GL_STATIC_DRAW) : m_pageSize(page_size), m_usage(usage)
+		{
+			if (page_size <= 0)
+				throw std::runtime_error("gl::BufferArena invalid page size");
+		}
+		BufferArena(const BufferArena&) = delete;
+		BufferArena(BufferArena&&) = default;
+		BufferArena& operator=(BufferArena&&) = default;
+
+		/**
+		 * @brief Allocate a range
+		 *
+		 * Take the smallest free block able to hold the range, creating a new page if none fits.
+		 *
+		 * @param count how many *MyStruct* to allocate
+		 * @param alignment alignment of the offset, in *MyStruct*
+		 * @return the allocated range
+		 */
+		Range allocate(GLsizeiptr count, GLsizeiptr alignment = 1)
+		{
+			if (count <= 0 || alignment <= 0)
+				throw std::runtime_error("gl::BufferArena::allocate invalid size");
+			Range range;
+			for (GLuint i = 0; i < m_pages.size(); ++i)
+				if (m_pages[i] && allocate_in(i, count, alignment, range))
+					return range;
+			if (!allocate_in(add_page(glm::max(count, m_pageSize)), count, alignment, range))
+				throw std::runtime_error("gl::BufferArena::allocate failed");
+			return range;
+		}
+		/**
+		 * @brief Free a range
+		 *
+		 * The range is merged with its free neighbours. The range is reset.
+		 * Throws if the range isn't allocated in the arena (freed twice, or from another arena).
+		 */
+		void free(Range& range)
+		{
+			if (!range.valid())
+				return;
+			if (range.page >= m_pages.size() || !m_pages[range.page])
+				throw std::runtime_error("gl::BufferArena::free invalid range");
+			Page& page = *m_pages[range.page];
+			GLsizeiptr offset = range.offset, count = range.count;
+			if (offset < 0 || count <= 0 || offset + count > page.capacity() || count > page.used)
+				throw std::runtime_error("gl::BufferArena::free invalid range");
+			auto next = page.byOffset.lower_bound(offset);
+			auto prev = next;
+			if (prev != page.byOffset.begin())
+				--prev;
+			else
+				prev = page.byOffset.end();
+			// A free neighbour overlapping the range : it's not allocated
+			if ((next != page.byOffset.end() && next->first < offset + count) || (prev != page.byOffset.end() && prev->first + prev->second > offset))
+				throw std::runtime_error("gl::BufferArena::free range not allocated");
+			// Merge with next free block
+			if (next != page.byOffset.end() && next->first == offset + count)
+			{
+				count += next->second;
+				erase_free(page, next);
+			}
+			// Merge with previous free block
+			if (prev != page.byOffset.end() && prev->first + prev->second == offset)
+			{
+				offset = prev->first;
+				count += prev->second;
+				erase_free(page, prev);
+			}
+			insert_free(page, offset, count);
+			page.used -= range.count;
+			range = Range();
+		}
+		/**
+		 * @brief Give back the storage of the pages without any allocated range
+		 *
+		 * The indices of the other pages don't change : the index of a released page is taken again by a next new page.
+		 */
+		void trim()
+		{
+			for (auto& page : m_pages)
+				if (page && page->used == 0)
+					page.reset();
+			while (!m_pages.empty() && !m_pages.back())
+				m_pages.pop_back();
+		}
+		/// Upload data in a range, *offset* being relative to the range.
+		void set(const Range& range, const MyStruct* data, GLsizeiptr count, GLsizeiptr offset = 0)
+		{
+			if (!range.valid() || offset < 0 || offset + count > range.count)
+				throw std::runtime_error("gl::BufferArena::set OOB");
+			BufferBase& buffer = page(range.page);
+#if LIBGLW_WITH_DSA
+			glNamedBufferSubData(buffer.id(), (range.offset + offset) * sizeof(MyStruct), count * sizeof(MyStruct), data);
+#else
+			buffer.bind();
+			glBufferSubData(target, (range.offset + offset) * sizeof(MyStruct), count * sizeof(MyStruct), data);
+#endif
+		}
+		void set(const Range& range, const std::vector<MyStruct>& data, GLsizeiptr offset = 0)
+		{
+			set(range, data.data(), static_cast<GLsizeiptr>(data.size()), offset);
+		}
+		/// Buffer of a page, to bind or to attach to a VAO.
+		BufferBase& page(GLuint index)
+		{
+			if (!m_pages.at(index))
+				throw std::runtime_error("gl::BufferArena::page released");
+			return *m_pages[index];
+		}
+		const BufferBase& page(GLuint index) const
+		{
+			if (!m_pages.at(index))
+				throw std::runtime_error("gl::BufferArena::page released");
+			return *m_pages[index];
+		}
+		/// Number of page indices, released pages included
+		GLuint page_count() const
+		{
+			return static_cast<GLuint>(m_pages.size());
+		}
+		/// Number of *MyStruct* allocated in every pages
+		GLsizeiptr used() const
+		{
+			GLsizeiptr total = 0;
+			for (auto& page : m_pages)
+				if (page)
+					total += page->used;
+			return total;
+		}
+		/// Number of *MyStruct* reserved by every pages
+		GLsizeiptr capacity() const
+		{
+			GLsizeiptr total = 0;
+			for (auto& page : m_pages)
+				if (page)
+					total += page->capacity();
+			return total;
+		}
+	private:
+		struct Page : public BufferBase
+		{
+			~Page()
+			{
+				this->destroy();
+			}
+			/// Free blocks : offset -> size
+			std::map<GLsizeiptr, GLsizeiptr> byOffset;
+			/// Free blocks : size -> offset
+			std::multimap<GLsizeiptr, GLsizeiptr> bySize;
+			GLsizeiptr used = 0;
+		};
+		/// Create a page, in the first released index. Return its index.
+		GLuint add_page(GLsizeiptr size)
+		{
+			std::unique_ptr<Page> page(new Page());
+			page->instantiate();
+			page->force_reserve(size, m_usage);
+			insert_free(*page, 0, size);
+			for (GLuint i = 0; i < m_pages.size(); ++i)
+				if (!m_pages[i])
+				{
+					m_pages[i] = std::move(page);
+					return i;
+				}
+			m_pages.push_back(std::move(page));
+			return static_cast<GLuint>(m_pages.size() - 1);
+		}
+		bool allocate_in(GLuint index, GLsizeiptr count, GLsizeiptr alignment, Range& range)
+		{
+			Page& page = *m_pages[index];
+			for (auto it = page.bySize.lower_bound(count); it != page.bySize.end(); ++it)
+			{
+				const GLsizeiptr blockOffset = it->second, blockSize = it->first;
+				const GLsizeiptr aligned = (blockOffset + alignment - 1) / alignment * alignment;
+				const GLsizeiptr padding = aligned - blockOffset;
+				if (padding + count > blockSize)
+					continue;
+				erase_free(page, page.byOffset.find(blockOffset));
+				if (padding > 0)
+					insert_free(page, blockOffset, padding);
+				if (padding + count < blockSize)
+					insert_free(page, aligned + count, blockSize - padding - count);
+				page.used += count;
+				range.page = index;
+				range.offset = aligned;
+				range.count = count;
+				return true;
+			}
+			return false;
+		}
+		static void insert_free(Page& page, GLsizeiptr offset, GLsizeiptr count)
+		{
+			page.byOffset.emplace(offset, count);
+			page.bySize.emplace(count, offset);
+		}
+		static void erase_free(Page& page, typename std::map<GLsizeiptr, GLsizeiptr>::iterator it)
+		{
+			auto range = page.bySize.equal_range(it->second);
+			for (auto sized = range.first; sized != range.second; ++sized)
+				if (sized->second == it->first)
+				{
+					page.bySize.erase(sized);
+					break;
+				}
+			page.byOffset.erase(it);
+		}
+
+		std::vector<std::unique_ptr<Page>> m_pages;
+		GLsizeiptr m_pageSize;
+		GLenum m_usage;
+	};
+	template <typename MyStruct>
+	using ArrayBufferArena = BufferArena<GL_ARRAY_BUFFER, MyStruct>;
+	template <typename Integer>
+	using ElementBufferArena = BufferArena<GL_ELEMENT_ARRAY_BUFFER, Integer>;
+}
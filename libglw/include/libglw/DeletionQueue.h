@@ -0,0 +1,105 @@
+#pragma once
+#include <GL/glew.h>
+#include <atomic>
+#include <deque>
+#include "config.h"
+
+namespace gl
+{
+	/**
+	 * @brief Deferred destruction of OpenGL names
+	 *
+	 * In deferred mode (see SetDeferred), destroying an object doesn't call OpenGL : its name is pushed in a lock-free queue,
+	 * so objects can be released from any thread, and no deletion happens in the middle of a frame.
+	 * The GL thread deletes the queued names in one batch with process(), at the end of a frame for example :
+	 * ```cpp
+	 * gl::DeletionQueue::SetDeferred(true);
+	 * // ... frame
+	 * gl::DeletionQueue::Global().process();
+	 * ```
+	 * With setFenced(true), process() places a fence after each batch and deletes it only once the GPU passed the fence.
+	 *
+	 * Only the names are deferred : objects with more state to release (mapped StreamingBuffer...) still need the GL thread.
+	 */
+	class DeletionQueue
+	{
+	public:
+		/// Kind of the queued name
+		enum class Kind
+		{
+			Buffer,
+			VertexArray,
+			Texture,
+			Sampler,
+			Framebuffer,
+			Renderbuffer,
+			ProgramPipeline,
+			Program,
+			Shader
+		};
+		DeletionQueue() = default;
+		DeletionQueue(const DeletionQueue&) = delete;
+		DeletionQueue& operator=(const DeletionQueue&) = delete;
+		/// Free the memory of the queue. Names still queued are not deleted : call flush before destroying the context.
+		~DeletionQueue();
+
+		/// Queue used by the objects of libglw
+		static DeletionQueue& Global();
+		/// Enable deferred destruction of the objects.
+		static void SetDeferred(bool enabled);
+		static bool GetDeferred();
+		/**
+		 * @brief Release a name
+		 *
+		 * Push the name in the global queue in deferred mode, delete it now otherwise.
+		 * The queued names are given back to the NamePools, deleted by batches at the end of process and flush.
+		 * @param target Target of a texture (needed with DSA)
+		 */
+		static void Release(Kind kind, GLuint name, GLenum target = 0);
+
+		/// Queue a name. Thread safe and lock-free.
+		void push(Kind kind, GLuint name, GLenum target = 0);
+		/**
+		 * @brief Delete the queued names, on the GL thread
+		 *
+		 * When fenced, the names queued since the last call wait for the GPU in a new batch, and the batches whose fence is signaled are deleted.
+		 * @return how many names have been deleted
+		 */
+		size_t process();
+		/// Delete every queued and waiting name now, without waiting for the GPU.
+		size_t flush();
+		/// Wait for the GPU before deleting names.
+		void setFenced(bool enabled)
+		{
+			m_fenced = enabled;
+		}
+		bool fenced() const
+		{
+			return m_fenced;
+		}
+	private:
+		struct Node
+		{
+			Kind kind;
+			GLuint name;
+			GLenum target;
+			Node* next;
+		};
+		/// Names waiting for a fence
+		struct Batch
+		{
+			GLsync sync;
+			Node* nodes;
+		};
+		/// Take every pushed node
+		Node* take();
+		/// Delete the names of a list and free the list
+		static size_t release(Node* nodes);
+		/// Give a name back to its pool, deleting it now unless *batched* (the caller flushes the pools)
+		static void releaseNow(Kind kind, GLuint name, GLenum target, bool batched);
+
+		std::atomic<Node*> m_head{nullptr};
+		std::deque<Batch> m_batches;
+		bool m_fenced = false;
+	};
+}
@@ -6,7 +6,17 @@
 #include <memory>
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <vector>
+#include <algorithm>
+#include <iterator>
+#include <cstdint>
+#include <cstring>
+#include "config.h"
+#include "StateCache.h"
+#include "NamePool.h"
+#include "DeletionQueue.h"
+#include "Layout.h"
 //#include "GLC_Object.h"
 #define DECL_UPTR(T) using uptr = std::unique_ptr<T>;
 #define DECL_SPTR(T) using sptr = std::shared_ptr<T>;
@@ -39,7 +49,7 @@ namespace gl
 		Object(Object&&);
 		Object(const Object&) = delete;
 		Object& operator=(const Object&) = delete;
-		Object& operator=(Object&&) = default;
+		Object& operator=(Object&&);
 		virtual ~Object();
 		/**
 		 * @brief OpenGL ID returns
@@ -63,6 +73,7 @@ namespace gl
 		 * @brief OpenGL ID generator
 		 * 
 		 * Used to create the new OpenGL object by using glGen*. Could also init some default parameters.
+		 * Names are taken from the NamePools of the current thread, which generates them by blocks.
 		 * Have to be declared in inherited class
 		 */
 		virtual void instantiate() = 0;
@@ -96,6 +107,8 @@ namespace gl
 		 * @brief OpenGL ID destroyer
 		 * 
 		 * Used to destroy the OpenGL object by using glDelete*.
+		 * The name is given back to the NamePools of the current thread, which deletes them by batches,
+		 * or queued in the DeletionQueue in deferred mode.
 		 * Have to be declared in inherited class
 		 */
 		virtual void destroy() = 0;
@@ -138,7 +151,10 @@ namespace gl
 	{
 	public:
 		DECL_PTR(VertexArray)
+		/// Attributes tracked by enable/disable
+		constexpr static int MaxAttribs = 32;
 		VertexArray();
+		/// Wrap an existing VAO. Its enabled attributes are queried once, on first isEnabled.
 		VertexArray(GLuint id);
 		~VertexArray();
 		/// Enable a vertex attrib.
@@ -150,6 +166,8 @@ namespace gl
 		/// @see [glDisableVertexAttribArray](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glDisableVertexAttribArray.xhtml)
 		void disable(int );
 		/// Return vertex attribute is enabled.
+		/// 
+		/// Answered from the attributes enabled through this object, without querying the driver.
 		/// @param index Vertex attribute
 		/// @return true if enabled
 		/// @see [glGetVertexAttribiv](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glGetVertexAttribiv.xhtml)(index, GL_VERTEX_ATTRIB_ARRAY_ENABLED, myvar)
@@ -163,6 +181,55 @@ namespace gl
 		/// @copydoc Object::destroy
 		/// @see [glDeleteVertexArrays](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glDeleteVertexArrays.xhtml)
 		virtual void destroy();
+	private:
+		static uint32_t attribBit(int index);
+		/// Query the driver, needed for VAOs created outside of libglw
+		bool queryEnabled(int index) const;
+
+		/// Enabled attributes, one bit per index
+		mutable uint32_t m_enabled = 0;
+		/// Attributes whose state is known
+		mutable uint32_t m_known = ~0u;
+	};
+	/**
+	 * @brief Fence sync object
+	 *
+	 * Wrapper for OpenGL sync objects. It's not an Object since sync objects are GLsync handles, not GLuint names.
+	 * Used to know when the GPU is done with commands issued before place().
+	 */
+	class Fence
+	{
+	public:
+		Fence();
+		Fence(Fence&&);
+		Fence(const Fence&) = delete;
+		Fence& operator=(const Fence&) = delete;
+		Fence& operator=(Fence&&);
+		~Fence();
+		/// Insert a new fence in the command stream, replacing the previous one.
+		/// @see [glFenceSync](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glFenceSync.xhtml)
+		void place();
+		/// Return true if a fence has been placed and not waited yet.
+		bool isPlaced() const
+		{
+			return m_sync != nullptr;
+		}
+		/// Return true if the GPU passed the fence (or if no fence is placed). Never blocks, throws if the wait fails.
+		bool isSignaled();
+		/**
+		 * @brief Wait for the GPU to pass the fence
+		 *
+		 * Release the sync object once signaled.
+		 *
+		 * @param timeout Timeout in nanoseconds
+		 * @return false if the timeout expired before the fence was signaled
+		 * @see [glClientWaitSync](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glClientWaitSync.xhtml)
+		 */
+		bool wait(GLuint64 timeout = GL_TIMEOUT_IGNORED);
+		/// Delete the sync object without waiting.
+		void reset();
+	private:
+		GLsync m_sync = nullptr;
 	};
 	/**
 	 * @brief Buffer object
@@ -176,17 +243,146 @@ namespace gl
 	class Buffer : public Object
 	{
 	public:
+		/// Upload counters of the shadow copy mode
+		struct ShadowStats
+		{
+			/// Bytes written in the shadow copy by subset and write
+			uint64_t bytesWritten = 0;
+			/// Bytes sent to OpenGL by flush
+			uint64_t bytesUploaded = 0;
+			/// glBufferSubData calls issued by flush
+			uint64_t uploads = 0;
+		};
+		/**
+		 * @brief Mapped range of a Buffer
+		 *
+		 * Typed view returned by Buffer::map_range. The range is unmapped when the view is destroyed.
+		 */
+		class Mapping
+		{
+		public:
+			Mapping() = default;
+			Mapping(const Buffer& buffer, MyStruct* data, GLsizeiptr count, GLbitfield flags) : m_buffer(&buffer), m_data(data), m_count(count), m_flags(flags)
+			{
+				buffer.m_mapping = this;
+			}
+			Mapping(const Mapping&) = delete;
+			Mapping& operator=(const Mapping&) = delete;
+			Mapping(Mapping&& other)
+			{
+				swap(other);
+			}
+			Mapping& operator=(Mapping&& other)
+			{
+				swap(other);
+				return *this;
+			}
+			~Mapping()
+			{
+				unmap();
+			}
+			void swap(Mapping& other)
+			{
+				// The buffers follow their current view
+				const bool current = m_buffer && m_buffer->m_mapping == this;
+				const bool otherCurrent = other.m_buffer && other.m_buffer->m_mapping == &other;
+				using std::swap;
+				swap(m_buffer, other.m_buffer);
+				swap(m_data, other.m_data);
+				swap(m_count, other.m_count);
+				swap(m_flags, other.m_flags);
+				if (otherCurrent)
+					m_buffer->m_mapping = this;
+				if (current)
+					other.m_buffer->m_mapping = &other;
+			}
+			MyStruct* data() const
+			{
+				return m_data;
+			}
+			/// Number of *MyStruct* mapped
+			GLsizeiptr size() const
+			{
+				return m_count;
+			}
+			MyStruct* begin() const
+			{
+				return m_data;
+			}
+			MyStruct* end() const
+			{
+				return m_data + m_count;
+			}
+			MyStruct& operator[](GLsizeiptr index) const
+			{
+				return m_data[index];
+			}
+			explicit operator bool() const
+			{
+				return m_data != nullptr;
+			}
+			/// Access flags given to map_range
+			GLbitfield flags() const
+			{
+				return m_flags;
+			}
+			/**
+			 * @brief Flush a part of the mapped range
+			 *
+			 * Only useful with GL_MAP_FLUSH_EXPLICIT_BIT.
+			 * @param first index relative to the mapped range
+			 * @param count how many *MyStruct* to flush
+			 * @see [glFlushMappedBufferRange](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glFlushMappedBufferRange.xhtml)
+			 */
+			void flush(GLsizeiptr first, GLsizeiptr count) const
+			{
+				if (first + count > m_count)
+					throw std::runtime_error("gl::Buffer::Mapping::flush OOB");
+#if LIBGLW_WITH_DSA
+				glFlushMappedNamedBufferRange(m_buffer->id(), first * sizeof(MyStruct), count * sizeof(MyStruct));
+#else
+				m_buffer->bind();
+				glFlushMappedBufferRange(target, first * sizeof(MyStruct), count * sizeof(MyStruct));
+#endif
+			}
+			/// Flush the whole mapped range.
+			void flush() const
+			{
+				flush(0, m_count);
+			}
+			/// Unmap the range before the view is destroyed. Nothing is done if the buffer was unmapped meanwhile.
+			void unmap()
+			{
+				if (m_data && m_buffer->m_mapping == this)
+					m_buffer->unmap();
+				m_data = nullptr;
+				m_count = 0;
+			}
+		private:
+			friend class Buffer;
+			const Buffer* m_buffer = nullptr;
+			MyStruct* m_data = nullptr;
+			GLsizeiptr m_count = 0;
+			GLbitfield m_flags = 0;
+		};
 		Buffer() : m_size(0), m_capacity(0), m_map(nullptr)
 		{
 			if (Object::GetAutoInstantiate())
 				instantiate();
 		}
 		Buffer(const Buffer&) = delete;
-		Buffer(Buffer&& other) : Object(std::move(other)), m_size(other.m_size), m_capacity(other.m_capacity), m_map(other.m_map)
+		Buffer(Buffer&& other) : Object(std::move(other)), m_size(other.m_size), m_capacity(other.m_capacity), m_map(other.m_map), m_mapOffset(other.m_mapOffset), m_mapCount(other.m_mapCount), m_mapping(other.m_mapping), m_usage(other.m_usage), m_orphanOnMap(other.m_orphanOnMap), m_growth(other.m_growth), m_shadowed(other.m_shadowed), m_shadow(std::move(other.m_shadow)), m_dirty(std::move(other.m_dirty)), m_flushGap(other.m_flushGap), m_stats(other.m_stats)
 		{
+			other.m_shadowed = false;
 			other.m_capacity = 0;
 			other.m_size = 0;
 			other.m_map = 0;
+			other.m_mapOffset = 0;
+			other.m_mapCount = 0;
+			other.m_mapping = nullptr;
+			// The view of a map_range follows the buffer
+			if (m_mapping)
+				m_mapping->m_buffer = this;
 		}
 		/**
 		 * @brief Set buffer data
@@ -206,61 +402,210 @@ namespace gl
 		 */
 		void set(const MyStruct* data, uint32_t size, GLenum usage = GL_STREAM_DRAW)
 		{
-			bind();
 			m_size = m_capacity = size;
+			m_usage = usage;
+#if LIBGLW_WITH_DSA
+			glNamedBufferData(id(), size * sizeof(MyStruct), data, usage);
+#else
+			bind();
 			glBufferData(target, size * sizeof(MyStruct), data, usage);
+#endif
+			if (m_shadowed)
+			{
+				// set(nullptr, size) only allocates
+				if (data)
+					m_shadow.assign(data, data + size);
+				else
+					m_shadow.assign(size, MyStruct());
+				m_dirty.clear();
+			}
 		}
 		/**
 		 * @brief Set a part of buffer data using glBufferSubData
 		 * 
+		 * In shadow copy mode, data is written in the shadow copy and uploaded by flush.
+		 * 
+		 * @param offset First *MyStruct* to write
 		 * @param data 
-		 * @param usage Usage of the buffer
 		 */
 		void subset(GLintptr offset, const std::vector<MyStruct>& data)
 		{
-			if (offset+data.size()>=m_capacity)
+			subset(offset, data.data(), static_cast<GLsizeiptr>(data.size()));
+		}
+		void subset(GLintptr offset, const MyStruct* data, GLsizeiptr count)
+		{
+			if (offset < 0 || offset + count > m_capacity)
 				throw std::runtime_error("gl::Buffer::subset OOB");
 			// if (offset+data.size()>m_size)
 			// 	m_size = offset+data.size();
-			glBufferSubData(target, offset, data.size() * sizeof(MyStruct), data.data());
+			if (m_shadowed)
+			{
+				std::copy(data, data + count, m_shadow.begin() + offset);
+				mark_dirty(offset, offset + count);
+				m_stats.bytesWritten += count * sizeof(MyStruct);
+				return;
+			}
+#if LIBGLW_WITH_DSA
+			glNamedBufferSubData(id(), offset * sizeof(MyStruct), count * sizeof(MyStruct), data);
+#else
+			bind();
+			glBufferSubData(target, offset * sizeof(MyStruct), count * sizeof(MyStruct), data);
+#endif
+		}
+		/**
+		 * @brief Write one element
+		 * 
+		 * @see subset
+		 */
+		void write(GLintptr index, const MyStruct& value)
+		{
+			subset(index, &value, 1);
+		}
+		/**
+		 * @brief Shadow copy mode
+		 * 
+		 * When enabled, the buffer keeps a CPU copy of its content. subset and write only update the copy
+		 * and mark the range dirty, then flush uploads the dirty ranges, merged when they are close enough (see setFlushGap).
+		 * Scattered updates become a few uploads per frame.
+		 * 
+		 * Enabling it reads the current content back with glGetBufferSubData.
+		 * Note : map and map_range bypass the shadow copy.
+		 */
+		void setShadowed(bool enabled)
+		{
+			if (enabled == m_shadowed)
+				return;
+			if (!enabled)
+				flush();
+			m_shadowed = enabled;
+			m_dirty.clear();
+			if (!enabled)
+			{
+				std::vector<MyStruct>().swap(m_shadow);
+				return;
+			}
+			m_shadow.resize(m_capacity);
+			if (m_capacity > 0)
+			{
+#if LIBGLW_WITH_DSA
+				glGetNamedBufferSubData(id(), 0, m_capacity * sizeof(MyStruct), m_shadow.data());
+#else
+				bind();
+				glGetBufferSubData(target, 0, m_capacity * sizeof(MyStruct), m_shadow.data());
+#endif
+			}
+		}
+		bool isShadowed() const
+		{
+			return m_shadowed;
+		}
+		/// Shadow copy content. Empty if not in shadow copy mode.
+		const std::vector<MyStruct>& shadow() const
+		{
+			return m_shadow;
+		}
+		/**
+		 * @brief Set the gap allowed between merged ranges
+		 * 
+		 * Dirty ranges separated by *gap* *MyStruct* or less are uploaded in one call, clean elements in between included.
+		 */
+		void setFlushGap(GLsizeiptr gap)
+		{
+			m_flushGap = glm::max<GLsizeiptr>(gap, 0);
+		}
+		GLsizeiptr flushGap() const
+		{
+			return m_flushGap;
+		}
+		/**
+		 * @brief Upload the dirty ranges of the shadow copy
+		 * 
+		 * @see setShadowed
+		 */
+		void flush()
+		{
+			if (m_dirty.empty())
+				return;
+#if !LIBGLW_WITH_DSA
+			bind();
+#endif
+			auto it = m_dirty.begin();
+			GLsizeiptr first = it->first, last = it->second;
+			for (++it; it != m_dirty.end(); ++it)
+			{
+				if (it->first - last <= m_flushGap)
+				{
+					last = it->second;
+					continue;
+				}
+				upload_shadow(first, last);
+				first = it->first;
+				last = it->second;
+			}
+			upload_shadow(first, last);
+			m_dirty.clear();
+		}
+		/// Number of dirty ranges waiting for flush, before merge
+		size_t dirty_count() const
+		{
+			return m_dirty.size();
+		}
+		const ShadowStats& stats() const
+		{
+			return m_stats;
+		}
+		void resetStats()
+		{
+			m_stats = ShadowStats();
 		}
 		/**
 		 * @brief Append or reduce data.
 		 * 
+		 * When the capacity is exceeded, it grows geometrically (see setGrowthFactor) and the content is kept.
+		 * 
 		 * @param size how many *MyStruct* to add/sub
 		 * @param usage Usage of the buffer 
 		 * @see reserve
 		 */
 		void reserve_relative(GLsizeiptr size, GLenum usage = GL_STREAM_DRAW)
 		{
-			m_size = m_size + size;
-			auto prevcapa = m_capacity;
-			m_capacity = glm::max<GLsizeiptr>(m_capacity, size);
-			if (prevcapa < m_capacity)
-			{
-				m_capacity = m_size;
-				m_capacity = m_capacity * 4 / 3;
-				bind();
-				glBufferData(target, m_capacity * sizeof(MyStruct), nullptr, usage);
-			}
+			auto prevsize = m_size;
+			m_size = glm::max<GLsizeiptr>(m_size + size, 0);
+			if (m_size > m_capacity)
+				reallocate(grown_capacity(m_size), prevsize, usage);
 		}
 		/**
 		 * @brief Create and reserve data
 		 * 
 		 * Note : works like std::vector with a size AND a capacity.
+		 * When the capacity is exceeded, it grows geometrically (see setGrowthFactor) and the content is kept.
 		 * 
 		 * @see [glBufferData](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glBufferData.xhtml)
 		 */
 		void reserve(GLsizeiptr size, GLenum usage = GL_STREAM_DRAW)
 		{
+			auto prevsize = m_size;
 			m_size = size;
-			auto prevcapa = m_capacity;
-			m_capacity = glm::max<GLsizeiptr>(m_capacity, size);
-			if (prevcapa < m_capacity)
-			{
-				bind();
-				glBufferData(target, m_capacity * sizeof(MyStruct), nullptr, usage);
-			}
+			if (m_size > m_capacity)
+				reallocate(grown_capacity(m_size), prevsize, usage);
+		}
+		/**
+		 * @brief Set the growth factor of the capacity
+		 * 
+		 * When reserve or reserve_relative exceed the capacity, the new capacity is at least the old one multiplied by this factor.
+		 * Default is 4/3.
+		 * 
+		 * @param factor Growth factor, greater than 1
+		 */
+		void setGrowthFactor(float factor)
+		{
+			if (factor <= 1.f)
+				throw std::runtime_error("gl::Buffer::setGrowthFactor factor must be greater than 1");
+			m_growth = factor;
+		}
+		float growthFactor() const
+		{
+			return m_growth;
 		}
 		/**
 		 * @brief Create and reserve data to exact size
@@ -275,23 +620,31 @@ namespace gl
 		{
 			m_size = size;
 			m_capacity = size;
+			m_usage = usage;
+#if LIBGLW_WITH_DSA
+			glNamedBufferData(id(), m_capacity * sizeof(MyStruct), nullptr, usage);
+#else
 			bind();
 			glBufferData(target, m_capacity * sizeof(MyStruct), nullptr, usage);
+#endif
+			if (m_shadowed)
+			{
+				m_shadow.assign(m_capacity, MyStruct());
+				m_dirty.clear();
+			}
 		}
 		/**
 		 * @brief Shrink the data to correspond to size instead of capacity
 		 *
-		 * Warning : it doesn't copy old data into new one !
+		 * The content is kept.
 		 *
-		 * @see [glBufferData](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glBufferData.xhtml)
+		 * @see reallocate
 		 */
 		void shrink_to_fit()
 		{
 			if (m_capacity == m_size)
 				return;
-			m_capacity = m_size;
-			bind();
-			glBufferData(target, m_capacity * sizeof(MyStruct), nullptr, GL_STREAM_DRAW);
+			reallocate(m_size, m_size, m_usage);
 		}
 		/// Return the size to use
 		GLsizeiptr size() const
@@ -305,16 +658,17 @@ namespace gl
 		}
 		void bind() const
 		{
-			glBindBuffer(target, id());
+			StateCache::Current().bindBuffer(target, id());
 		}
 		void unbind() const
 		{
-			glBindBuffer(target, 0);
+			StateCache::Current().bindBuffer(target, 0);
 		}
 		/**
 		 * @brief Get mapped data
 		 * 
 		 * Once buffer data mapped, you can access it by this pointer.
+		 * With map_range, it points to the first mapped element.
 		 * 
 		 * @return mapped data 
 		 * @see operator[]
@@ -330,8 +684,7 @@ namespace gl
 		/**
 		 * @brief Get mapped data
 		 * 
-		 * Once buffer data mapped, you can access it by this pointer.
-		 * !BE CAREFUL! : use this function with already mapped data !
+		 * The buffer must be mapped (map or map_range), the index being in the mapped range.
 		 * 
 		 * @param index Offset in the array buffer.
 		 * @return Value of buffer at index.
@@ -340,37 +693,121 @@ namespace gl
 		MyStruct& operator[](GLuint index)
 		{
 			if (!m_map)
-				map(GL_READ_WRITE);
-				//throw std::runtime_error("Buffer map not accessible");
-			return m_map[index];
+				throw std::runtime_error("gl::Buffer::operator[] buffer not mapped");
+			if (static_cast<GLsizeiptr>(index) < m_mapOffset || static_cast<GLsizeiptr>(index) >= m_mapOffset + m_mapCount)
+				throw std::runtime_error("gl::Buffer::operator[] OOB");
+			return m_map[index - m_mapOffset];
+		}
+		/**
+		 * @brief Map a range of the buffer
+		 *
+		 * Unlike map, only the range is synchronized, and access flags give control on it :
+		 * - GL_MAP_INVALIDATE_RANGE_BIT / GL_MAP_INVALIDATE_BUFFER_BIT : previous content is discarded
+		 * - GL_MAP_UNSYNCHRONIZED_BIT : no synchronization at all, the caller guarantees the GPU isn't using the range
+		 * - GL_MAP_FLUSH_EXPLICIT_BIT : modifications are visible only after Mapping::flush
+		 *
+		 * When orphan on map is enabled (see setOrphanOnMap) and the whole content is overwritten
+		 * (write only with GL_MAP_INVALIDATE_BUFFER_BIT, or range covering the whole buffer), the storage is orphaned first
+		 * so that the map never waits for draws still using the previous storage.
+		 *
+		 * @param offset First *MyStruct* to map
+		 * @param count How many *MyStruct* to map
+		 * @param flags Access flags
+		 * @return view of the mapped range, unmapped at destruction
+		 * @see [glMapBufferRange](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glMapBufferRange.xhtml)
+		 */
+		Mapping map_range(GLsizeiptr offset, GLsizeiptr count, GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT)
+		{
+			if (offset < 0 || count <= 0 || offset + count > m_capacity)
+				throw std::runtime_error("gl::Buffer::map_range OOB");
+			if (m_map)
+				throw std::runtime_error("gl::Buffer::map_range already mapped");
+			const bool writeOnly = (flags & GL_MAP_WRITE_BIT) && !(flags & GL_MAP_READ_BIT);
+			const bool whole = (flags & GL_MAP_INVALIDATE_BUFFER_BIT) || (offset == 0 && count == m_capacity);
+			const bool orphan = m_orphanOnMap && writeOnly && whole;
+			if (orphan)
+				flags &= ~(GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+#if LIBGLW_WITH_DSA
+			if (orphan)
+				glNamedBufferData(id(), m_capacity * sizeof(MyStruct), nullptr, m_usage);
+			m_map = reinterpret_cast<MyStruct*>(glMapNamedBufferRange(id(), offset * sizeof(MyStruct), count * sizeof(MyStruct), flags));
+#else
+			bind();
+			if (orphan)
+				glBufferData(target, m_capacity * sizeof(MyStruct), nullptr, m_usage);
+			m_map = reinterpret_cast<MyStruct*>(glMapBufferRange(target, offset * sizeof(MyStruct), count * sizeof(MyStruct), flags));
+#endif
+			if (!m_map)
+				throw std::runtime_error("gl::Buffer::map_range failed");
+			m_mapOffset = offset;
+			m_mapCount = count;
+			return Mapping(*this, m_map, count, flags);
+		}
+		/**
+		 * @brief Orphan on map policy
+		 *
+		 * When enabled, map_range reallocates the storage (glBufferData with nullptr) before mapping
+		 * a range that overwrites the whole buffer. Useful for dynamic buffers rewritten every frame.
+		 */
+		void setOrphanOnMap(bool enabled)
+		{
+			m_orphanOnMap = enabled;
+		}
+		bool orphanOnMap() const
+		{
+			return m_orphanOnMap;
 		}
 		/// Map buffer.
 		/// @see [glMapBuffer](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glMapBuffer.xhtml)
 		MyStruct* map(GLenum access)
 		{
+			m_mapOffset = 0;
+			m_mapCount = m_capacity;
+#if LIBGLW_WITH_DSA
+			return m_map = reinterpret_cast<MyStruct*>(glMapNamedBuffer(id(), access));
+#else
 			bind();
 			return m_map = reinterpret_cast<MyStruct*>(glMapBuffer(target, access));
+#endif
 		}
 		/// Map buffer in Write Only mode.
 		/// @see [glMapBuffer](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glMapBuffer.xhtml)
 		MyStruct* map_write()
 		{
+			m_mapOffset = 0;
+			m_mapCount = m_capacity;
+#if LIBGLW_WITH_DSA
+			return m_map = reinterpret_cast<MyStruct*>(glMapNamedBuffer(id(), GL_WRITE_ONLY));
+#else
 			bind();
 			return m_map = reinterpret_cast<MyStruct*>(glMapBuffer(target, GL_WRITE_ONLY));
+#endif
 		}
 		/// Map buffer in Read Only mode.
 		/// @see [glMapBuffer](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glMapBuffer.xhtml)
 		const MyStruct* map_read() const 
 		{
+			m_mapOffset = 0;
+			m_mapCount = m_capacity;
+#if LIBGLW_WITH_DSA
+			return m_map = reinterpret_cast<MyStruct*>(glMapNamedBuffer(id(), GL_READ_ONLY));
+#else
 			bind();
 			return m_map = reinterpret_cast<MyStruct*>(glMapBuffer(target, GL_READ_ONLY));
+#endif
 		}
 		/// Map buffer in Read Write mode.
 		/// @see [glMapBuffer](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glMapBuffer.xhtml)
 		MyStruct* map_readwrite()
 		{
+			m_mapOffset = 0;
+			m_mapCount = m_capacity;
+#if LIBGLW_WITH_DSA
+			return m_map = reinterpret_cast<MyStruct*>(glMapNamedBuffer(id(), GL_READ_WRITE));
+#else
 			bind();
 			return m_map = reinterpret_cast<MyStruct*>(glMapBuffer(target, GL_READ_WRITE));
+#endif
 		}
 		/// Unmap buffer.
 		/// @see [glUnmapBuffer](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glUnmapBuffer.xhtml)
@@ -378,18 +815,24 @@ namespace gl
 		{
 			if (m_map)
 			{
+#if LIBGLW_WITH_DSA
+				glUnmapNamedBuffer(id());
+#else
 				bind();
 				glUnmapBuffer(target);
+#endif
 				m_map = nullptr;
+				m_mapCount = 0;
+				m_mapping = nullptr;
 			}
 		}
 		/// @copydoc Object::instantiate
-		/// @see [glGenBuffers](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glGenBuffers.xhtml)
+		/// @see [glGenBuffers](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glGenBuffers.xhtml), [glCreateBuffers](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glCreateBuffers.xhtml) with DSA
 		virtual void instantiate()
 		{
 			GLuint myID = id();
-			if (!glIsBuffer(myID))
-				glGenBuffers(1, &myID);
+			if (myID == 0)
+				myID = NamePools::Current().buffers.acquire();
 			setID(myID);
 		}
 	protected:
@@ -398,18 +841,284 @@ namespace gl
 		/// @see [glDeleteBuffers](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glDeleteBuffers.xhtml)
 		virtual void destroy()
 		{
-			GLuint myID = id();
-			if (glIsBuffer(myID))
-				glDeleteBuffers(1, &myID);
-			setID(myID);
+			// A released name is still alive : unmap it now, unless it may be another thread
+			if (!DeletionQueue::GetDeferred())
+				unmap();
+			m_map = nullptr;
+			m_mapCount = 0;
+			m_mapping = nullptr;
+			DeletionQueue::Release(DeletionQueue::Kind::Buffer, id());
+			setID(0);
 		}
 		/// Return the target setted in the template
 		virtual GLenum getTarget() const
 		{
 			return target;
 		}
+		/**
+		 * @brief Reallocate the storage keeping the content
+		 * 
+		 * The first *keep* elements are copied on the GPU side, through a scratch buffer so that the buffer name doesn't change :
+		 * VAOs and binding points referencing this buffer stay valid.
+		 * 
+		 * @param capacity New capacity
+		 * @param keep How many *MyStruct* to keep from the old storage
+		 * @param usage Usage of the buffer
+		 * @see [glCopyBufferSubData](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glCopyBufferSubData.xhtml)
+		 */
+		void reallocate(GLsizeiptr capacity, GLsizeiptr keep, GLenum usage)
+		{
+			unmap();
+			keep = glm::min(keep, glm::min(capacity, m_capacity));
+			const GLsizeiptr bytes = keep * sizeof(MyStruct);
+			GLuint scratch = 0;
+			m_capacity = capacity;
+			m_usage = usage;
+#if LIBGLW_WITH_DSA
+			if (bytes > 0)
+			{
+				glCreateBuffers(1, &scratch);
+				glNamedBufferData(scratch, bytes, nullptr, GL_STREAM_COPY);
+				glCopyNamedBufferSubData(id(), scratch, 0, 0, bytes);
+			}
+			glNamedBufferData(id(), m_capacity * sizeof(MyStruct), nullptr, usage);
+			if (bytes > 0)
+			{
+				glCopyNamedBufferSubData(scratch, id(), 0, 0, bytes);
+				glDeleteBuffers(1, &scratch);
+			}
+#else
+			StateCache& cache = StateCache::Current();
+			if (bytes > 0)
+			{
+				glGenBuffers(1, &scratch);
+				cache.bindBuffer(GL_COPY_WRITE_BUFFER, scratch);
+				glBufferData(GL_COPY_WRITE_BUFFER, bytes, nullptr, GL_STREAM_COPY);
+				cache.bindBuffer(GL_COPY_READ_BUFFER, id());
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, bytes);
+			}
+			bind();
+			glBufferData(target, m_capacity * sizeof(MyStruct), nullptr, usage);
+			if (bytes > 0)
+			{
+				cache.bindBuffer(GL_COPY_READ_BUFFER, scratch);
+				cache.bindBuffer(GL_COPY_WRITE_BUFFER, id());
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, bytes);
+				glDeleteBuffers(1, &scratch);
+				cache.deletedBuffer(scratch);
+			}
+#endif
+			if (m_shadowed)
+			{
+				m_shadow.resize(m_capacity);
+				// Dirty ranges past the new capacity are dropped, the others are still to upload
+				m_dirty.erase(m_dirty.lower_bound(m_capacity), m_dirty.end());
+				if (!m_dirty.empty())
+				{
+					auto last = std::prev(m_dirty.end());
+					last->second = glm::min(last->second, m_capacity);
+				}
+			}
+		}
+		/// Add [first, last[ to the dirty ranges, merged with overlapping and adjacent ones
+		void mark_dirty(GLsizeiptr first, GLsizeiptr last)
+		{
+			if (first >= last)
+				return;
+			auto it = m_dirty.upper_bound(first);
+			if (it != m_dirty.begin() && std::prev(it)->second >= first)
+				--it;
+			while (it != m_dirty.end() && it->first <= last)
+			{
+				first = glm::min(first, it->first);
+				last = glm::max(last, it->second);
+				it = m_dirty.erase(it);
+			}
+			m_dirty.emplace_hint(it, first, last);
+		}
+		void upload_shadow(GLsizeiptr first, GLsizeiptr last)
+		{
+			const GLsizeiptr bytes = (last - first) * sizeof(MyStruct);
+#if LIBGLW_WITH_DSA
+			glNamedBufferSubData(id(), first * sizeof(MyStruct), bytes, m_shadow.data() + first);
+#else
+			glBufferSubData(target, first * sizeof(MyStruct), bytes, m_shadow.data() + first);
+#endif
+			m_stats.bytesUploaded += bytes;
+			++m_stats.uploads;
+		}
+		/// Capacity to allocate to hold at least *size* elements, following the growth factor
+		GLsizeiptr grown_capacity(GLsizeiptr size) const
+		{
+			return glm::max<GLsizeiptr>(size, static_cast<GLsizeiptr>(m_capacity * m_growth));
+		}
 		GLsizeiptr m_size=0, m_capacity=0;
 		mutable MyStruct* m_map=nullptr;
+		/// First mapped element when mapped with map_range
+		mutable GLsizeiptr m_mapOffset=0;
+		/// Number of mapped elements
+		mutable GLsizeiptr m_mapCount=0;
+		/// View returned by map_range, unmapping the buffer when destroyed
+		mutable Mapping* m_mapping=nullptr;
+		/// Usage given at the last allocation
+		GLenum m_usage=GL_STREAM_DRAW;
+		bool m_orphanOnMap=false;
+		float m_growth=4.f/3.f;
+		/// Shadow copy mode
+		bool m_shadowed=false;
+		std::vector<MyStruct> m_shadow;
+		/// Dirty ranges of the shadow copy : first -> last (excluded)
+		std::map<GLsizeiptr, GLsizeiptr> m_dirty;
+		GLsizeiptr m_flushGap=0;
+		ShadowStats m_stats;
+	};
+	/**
+	 * @brief Persistent mapped streaming buffer
+	 *
+	 * Immutable buffer storage split into *region_count* regions used as a ring, one per frame.
+	 * The storage is mapped once with GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT, so frames write
+	 * directly into the current region without any map/unmap call.
+	 * Each region is guarded by a Fence placed by commit(), next() waits for it before reusing the region.
+	 *
+	 * Typical frame :
+	 * ```cpp
+	 * MyStruct* v = stream.next();
+	 * // write up to region_size() elements in v
+	 * glDrawArrays(GL_TRIANGLES, stream.first(), count);
+	 * stream.commit();
+	 * ```
+	 *
+	 * Requires OpenGL 4.4 or ARB_buffer_storage.
+	 * @param target Kind of buffer
+	 * @param MyStruct Type to work with
+	 */
+	template <GLenum target, typename MyStruct>
+	class StreamingBuffer : public Buffer<target, MyStruct>
+	{
+	public:
+		DECL_PTR(StreamingBuffer)
+		StreamingBuffer() : Buffer<target, MyStruct>()
+		{}
+		StreamingBuffer(GLsizeiptr region_size, GLuint region_count = 3) : StreamingBuffer()
+		{
+			allocate(region_size, region_count);
+		}
+		StreamingBuffer(StreamingBuffer&&) = default;
+		~StreamingBuffer()
+		{
+			release();
+			this->destroy();
+		}
+		/**
+		 * @brief Create the immutable storage and map it
+		 *
+		 * @param region_size how many *MyStruct* a frame can write
+		 * @param region_count how many regions in the ring (3 is enough for most drivers)
+		 * @see [glBufferStorage](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glBufferStorage.xhtml)
+		 */
+		void allocate(GLsizeiptr region_size, GLuint region_count = 3)
+		{
+			if (region_size <= 0 || region_count == 0)
+				throw std::runtime_error("gl::StreamingBuffer::allocate invalid size");
+			// Immutable storage can't be respecified, a new buffer name is needed
+			release();
+			this->destroy();
+			this->instantiate();
+
+			constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			this->m_size = region_size;
+			this->m_capacity = region_size * region_count;
+#if LIBGLW_WITH_DSA
+			glNamedBufferStorage(this->id(), this->m_capacity * sizeof(MyStruct), nullptr, flags);
+			this->m_map = reinterpret_cast<MyStruct*>(glMapNamedBufferRange(this->id(), 0, this->m_capacity * sizeof(MyStruct), flags));
+#else
+			this->bind();
+			glBufferStorage(target, this->m_capacity * sizeof(MyStruct), nullptr, flags);
+			this->m_map = reinterpret_cast<MyStruct*>(glMapBufferRange(target, 0, this->m_capacity * sizeof(MyStruct), flags));
+#endif
+			if (!this->m_map)
+				throw std::runtime_error("gl::StreamingBuffer::allocate map failed");
+			this->m_mapOffset = 0;
+			this->m_mapCount = this->m_capacity;
+			m_fences.clear();
+			m_fences.resize(region_count);
+			m_region = region_count - 1;
+		}
+		/**
+		 * @brief Go to the next region of the ring
+		 *
+		 * Waits for the fence of the region if the GPU is still reading it.
+		 *
+		 * @return mapped pointer to the new current region
+		 */
+		MyStruct* next()
+		{
+			m_region = (m_region + 1) % static_cast<GLuint>(m_fences.size());
+			m_fences[m_region].wait();
+			return region_data();
+		}
+		/// Place the fence guarding the current region. Call it after the last command using the region.
+		void commit()
+		{
+			m_fences[m_region].place();
+		}
+		/// Mapped pointer to the current region.
+		MyStruct* region_data()
+		{
+			return this->m_map + first();
+		}
+		/// Index of the first element of the current region, to use as *first* in draw calls.
+		GLint first() const
+		{
+			return static_cast<GLint>(m_region * this->m_size);
+		}
+		/// Offset in bytes of the current region, for glBindBufferRange or glVertexAttribPointer.
+		GLintptr offset() const
+		{
+			return first() * sizeof(MyStruct);
+		}
+		/// Index of the current region.
+		GLuint region() const
+		{
+			return m_region;
+		}
+		/// Size of a region in *MyStruct*.
+		GLsizeiptr region_size() const
+		{
+			return this->m_size;
+		}
+		/// How many regions in the ring.
+		GLuint region_count() const
+		{
+			return static_cast<GLuint>(m_fences.size());
+		}
+		// Storage is immutable and mapped for good : those Buffer functions are forbidden
+		template <typename ...Args> void set(Args&&...) = delete;
+		template <typename ...Args> void subset(Args&&...) = delete;
+		template <typename ...Args> void write(Args&&...) = delete;
+		template <typename ...Args> void setShadowed(Args&&...) = delete;
+		template <typename ...Args> void flush(Args&&...) = delete;
+		template <typename ...Args> void reserve(Args&&...) = delete;
+		template <typename ...Args> void reserve_relative(Args&&...) = delete;
+		template <typename ...Args> void force_reserve(Args&&...) = delete;
+		template <typename ...Args> void shrink_to_fit(Args&&...) = delete;
+		template <typename ...Args> void map(Args&&...) = delete;
+		template <typename ...Args> void map_write(Args&&...) = delete;
+		template <typename ...Args> void map_read(Args&&...) = delete;
+		template <typename ...Args> void map_readwrite(Args&&...) = delete;
+		template <typename ...Args> void map_range(Args&&...) = delete;
+		template <typename ...Args> void setOrphanOnMap(Args&&...) = delete;
+		template <typename ...Args> void unmap(Args&&...) = delete;
+	private:
+		/// Wait for every region then unmap.
+		void release()
+		{
+			for (auto& fence : m_fences)
+				fence.wait();
+			Buffer<target, MyStruct>::unmap();
+		}
+		std::vector<Fence> m_fences;
+		GLuint m_region = 0;
 	};
 	template <typename Integer>
 	class ElementBuffer : public Buffer<GL_ELEMENT_ARRAY_BUFFER, Integer>
@@ -455,8 +1164,13 @@ namespace gl
 		template <typename ...Args>
 		void set_attrib(Args... args)
 		{
-			bindVAO();
-			this->bind();
+#if LIBGLW_WITH_DSA
+			if (!m_VAO)
+#endif
+			{
+				bindVAO();
+				this->bind();
+			}
 			set_attrib_priv(args...);
 		}
 		void attachVertexArray(VertexArray::sptr vao)
@@ -523,8 +1237,23 @@ namespace gl
 		template <int id>
 		void set_attrib_priv(Attrib<id> attrib)
 		{
+#if LIBGLW_WITH_DSA
+			if (m_VAO)
+			{
+				// One binding point per attribute, like glVertexAttribPointer does
+				const GLuint vao = m_VAO->id();
+				glVertexArrayVertexBuffer(vao, attrib.index, this->id(), 0, attrib.stride);
+				glVertexArrayAttribFormat(vao, attrib.index, attrib.size, attrib.type, attrib.normalized, static_cast<GLuint>(attrib.offset));
+				glVertexArrayAttribBinding(vao, attrib.index, attrib.index);
+				m_VAO->enable(attrib.index);
+				return;
+			}
+#endif
 			glVertexAttribPointer(attrib.index, attrib.size, attrib.type, attrib.normalized, attrib.stride, reinterpret_cast<GLvoid*>(attrib.offset));
-			glEnableVertexAttribArray(attrib.index);
+			if (m_VAO)
+				m_VAO->enable(attrib.index);
+			else
+				glEnableVertexAttribArray(attrib.index);
 		}
 		VertexArray::sptr m_VAO;
 		
@@ -553,47 +1282,317 @@ namespace gl
             m_bindPoint = bind_point;
             BufferBase::bind();
             glBindBufferBase(GL_UNIFORM_BUFFER, m_bindPoint, this->id());
+            StateCache::Current().bufferBound(GL_UNIFORM_BUFFER, this->id());
         }
         template <typename ...Args>
         void bind(Args... programs)
         {
             (bind(programs), ...);
         }
-        void bind(gl::sl::Program& program)
-        {
-            BufferBase::bind();
-            // int blockIndx= getBlockIndex(program, m_blockName);
-            
-            // if (blockIndx!=GL_INVALID_INDEX)
-            // {
-            //     glUniformBlockBinding(program.id(), blockIndx, m_bindPoint);
-            // }
-        }
-    protected:
-        // GLuint getBlockIndex(gl::sl::Program& program, std::string_view block_name)
-        // {
-        //     return glGetUniformBlockIndex(program.id(), block_name.data());
-        // }
+        /// Wire the block named by setName in *program* to the binding point of bindBase.
+        /// Defined in Shaders.h.
+        /// @see [glUniformBlockBinding](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glUniformBlockBinding.xhtml)
+        void bind(gl::sl::Program& program);
     private:
         GLuint m_bindPoint=0;
         std::string m_blockName;
     };
+	/**
+	 * @brief Uniform buffer of per-draw slices
+	 *
+	 * Instead of one set of glUniform* calls per object, the values of every draw are pushed in a CPU staging memory,
+	 * uploaded at once by upload, then each draw binds its slice to the block with glBindBufferRange :
+	 * ```cpp
+	 * gl::DynamicUniformBuffer<gl::Std140<glm::mat4, glm::vec4>> objects;
+	 * for (auto& object : scene)
+	 *     object.slice = objects.push(object.block);
+	 * objects.upload();
+	 * for (auto& object : scene)
+	 * {
+	 *     objects.bindRange(object.slice, 1);
+	 *     object.draw();
+	 * }
+	 * objects.reset();
+	 * ```
+	 * Slices are aligned on GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT. The storage is orphaned on each upload,
+	 * so the next frame doesn't wait for the GPU to finish reading the previous one.
+	 * @param MyStruct Content of the block, with its std140 layout (see gl::Std140)
+	 */
+	template <typename MyStruct>
+	class DynamicUniformBuffer : public Buffer<GL_UNIFORM_BUFFER, unsigned char>
+	{
+	public:
+		DECL_PTR(DynamicUniformBuffer)
+		using BufferBase = Buffer<GL_UNIFORM_BUFFER, unsigned char>;
+		DynamicUniformBuffer() : BufferBase()
+		{
+			static_assert(std::is_trivially_copyable<MyStruct>::value, "DynamicUniformBuffer template type must be trivially copyable.");
+		}
+		DynamicUniformBuffer(DynamicUniformBuffer&&) = default;
+		~DynamicUniformBuffer()
+		{
+			this->destroy();
+		}
+		/**
+		 * @brief Copy the values of a draw in the staging memory
+		 *
+		 * @return offset of the slice in bytes, for bindRange
+		 */
+		GLintptr push(const MyStruct& value)
+		{
+			const GLintptr offset = static_cast<GLintptr>(m_staging.size());
+			m_staging.resize(m_staging.size() + stride());
+			std::memcpy(m_staging.data() + offset, &value, sizeof(MyStruct));
+			return offset;
+		}
+		/// Reserve the staging memory of *count* slices
+		void reserve_slices(GLsizeiptr count)
+		{
+			m_staging.reserve(count * stride());
+		}
+		/**
+		 * @brief Upload every pushed slice in one call
+		 *
+		 * The storage is orphaned with glBufferData then filled with glBufferSubData.
+		 * It only grows, following the growth factor.
+		 */
+		void upload()
+		{
+			const GLsizeiptr bytes = static_cast<GLsizeiptr>(m_staging.size());
+			if (bytes == 0)
+				return;
+			m_size = bytes;
+			if (bytes > m_capacity)
+				m_capacity = grown_capacity(bytes);
+#if LIBGLW_WITH_DSA
+			glNamedBufferData(id(), m_capacity, nullptr, GL_STREAM_DRAW);
+			glNamedBufferSubData(id(), 0, bytes, m_staging.data());
+#else
+			bind();
+			glBufferData(GL_UNIFORM_BUFFER, m_capacity, nullptr, GL_STREAM_DRAW);
+			glBufferSubData(GL_UNIFORM_BUFFER, 0, bytes, m_staging.data());
+#endif
+		}
+		/**
+		 * @brief Bind a slice to a binding point
+		 *
+		 * @param offset Slice returned by push
+		 * @see [glBindBufferRange](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glBindBufferRange.xhtml)
+		 */
+		void bindRange(GLintptr offset, GLuint bind_point) const
+		{
+			if (offset < 0 || offset + static_cast<GLsizeiptr>(sizeof(MyStruct)) > m_size)
+				throw std::runtime_error("gl::DynamicUniformBuffer::bindRange slice not uploaded");
+			glBindBufferRange(GL_UNIFORM_BUFFER, bind_point, id(), offset, sizeof(MyStruct));
+			StateCache::Current().bufferBound(GL_UNIFORM_BUFFER, id());
+		}
+		/// Forget the pushed slices, to start a new frame. The slices uploaded stay valid until the next upload.
+		void reset()
+		{
+			m_staging.clear();
+		}
+		/// How many slices are pushed
+		GLsizeiptr slices() const
+		{
+			return static_cast<GLsizeiptr>(m_staging.size()) / stride();
+		}
+		/**
+		 * @brief Distance between two slices in bytes
+		 *
+		 * sizeof(MyStruct) rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, queried on first use.
+		 */
+		GLsizeiptr stride() const
+		{
+			if (m_stride == 0)
+			{
+				GLint alignment = 0;
+				glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+				alignment = glm::max(alignment, 1);
+				m_stride = (static_cast<GLsizeiptr>(sizeof(MyStruct)) + alignment - 1) / alignment * alignment;
+			}
+			return m_stride;
+		}
+		// Content is managed by push and upload : those Buffer functions are forbidden
+		template <typename ...Args> void set(Args&&...) = delete;
+		template <typename ...Args> void subset(Args&&...) = delete;
+		template <typename ...Args> void write(Args&&...) = delete;
+		template <typename ...Args> void reserve(Args&&...) = delete;
+		template <typename ...Args> void reserve_relative(Args&&...) = delete;
+		template <typename ...Args> void force_reserve(Args&&...) = delete;
+		template <typename ...Args> void shrink_to_fit(Args&&...) = delete;
+	private:
+		std::vector<unsigned char> m_staging;
+		mutable GLsizeiptr m_stride = 0;
+	};
+	/**
+	 * @brief Pixel buffer object
+	 *
+	 * Bytes given to glTexSubImage* from GL_PIXEL_UNPACK_BUFFER, or written by glReadPixels to GL_PIXEL_PACK_BUFFER.
+	 * While one is bound, the pixel pointers of those calls are offsets in the buffer : unbind it after use.
+	 * @param target GL_PIXEL_UNPACK_BUFFER or GL_PIXEL_PACK_BUFFER
+	 */
+	template <GLenum target>
+	class PixelBuffer : public Buffer<target, unsigned char>
+	{
+	public:
+		DECL_PTR(PixelBuffer)
+		static_assert(target == GL_PIXEL_UNPACK_BUFFER || target == GL_PIXEL_PACK_BUFFER, "gl::PixelBuffer target must be a pixel buffer");
+		PixelBuffer() : Buffer<target, unsigned char>()
+		{}
+		PixelBuffer(PixelBuffer&&) = default;
+		~PixelBuffer()
+		{
+			this->destroy();
+		}
+	};
+	using PixelUnpackBuffer = PixelBuffer<GL_PIXEL_UNPACK_BUFFER>;
+	using PixelPackBuffer = PixelBuffer<GL_PIXEL_PACK_BUFFER>;
 	
+	/**
+	 * @brief Name of a uniform with its hash
+	 *
+	 * Key of the location cache of gl::sl::Program. Built from a string literal, the hash is computed at compile time :
+	 * ```cpp
+	 * constexpr gl::UniformName modelmat("modelmat");
+	 * ```
+	 * The string isn't copied, it must outlive the UniformName.
+	 */
+	class UniformName
+	{
+	public:
+		constexpr UniformName(const char* name) : m_name(name), m_hash(Hash(name))
+		{}
+		constexpr UniformName(const char* name, uint32_t hash) : m_name(name), m_hash(hash)
+		{}
+		UniformName(const std::string& name) : UniformName(name.c_str())
+		{}
+		constexpr const char* c_str() const
+		{
+			return m_name;
+		}
+		constexpr uint32_t hash() const
+		{
+			return m_hash;
+		}
+		/// FNV-1a hash of a name
+		constexpr static uint32_t Hash(const char* name)
+		{
+			uint32_t hash = 2166136261u;
+			for (; *name; ++name)
+				hash = (hash ^ static_cast<uint8_t>(*name)) * 16777619u;
+			return hash;
+		}
+	private:
+		const char* m_name;
+		uint32_t m_hash;
+	};
+	namespace detail
+	{
+		/// @name Uniform upload
+		/// Set a uniform of *program* : with glProgramUniform* with DSA, otherwise by making *program* current first (through the StateCache).
+		/// @{
+		void upload(GLuint program, GLint location, const glm::mat4& value);
+		void upload(GLuint program, GLint location, const glm::mat3& value);
+		void upload(GLuint program, GLint location, const glm::mat2& value);
+		void upload(GLuint program, GLint location, const glm::vec4& value);
+		void upload(GLuint program, GLint location, const glm::vec3& value);
+		void upload(GLuint program, GLint location, const glm::vec2& value);
+		void upload(GLuint program, GLint location, float value);
+		void upload(GLuint program, GLint location, const glm::ivec4& value);
+		void upload(GLuint program, GLint location, const glm::ivec3& value);
+		void upload(GLuint program, GLint location, const glm::ivec2& value);
+		void upload(GLuint program, GLint location, int value);
+		void upload(GLuint program, GLint location, const glm::uvec4& value);
+		void upload(GLuint program, GLint location, const glm::uvec3& value);
+		void upload(GLuint program, GLint location, const glm::uvec2& value);
+		void upload(GLuint program, GLint location, uint32_t value);
+		/// @}
+
+		/// OpenGL type of a uniform, checked against the reflection of programs
+		template <typename Type>
+		struct UniformType;
+		template <> struct UniformType<glm::mat4> { constexpr static GLenum value = GL_FLOAT_MAT4; };
+		template <> struct UniformType<glm::mat3> { constexpr static GLenum value = GL_FLOAT_MAT3; };
+		template <> struct UniformType<glm::mat2> { constexpr static GLenum value = GL_FLOAT_MAT2; };
+		template <> struct UniformType<glm::vec4> { constexpr static GLenum value = GL_FLOAT_VEC4; };
+		template <> struct UniformType<glm::vec3> { constexpr static GLenum value = GL_FLOAT_VEC3; };
+		template <> struct UniformType<glm::vec2> { constexpr static GLenum value = GL_FLOAT_VEC2; };
+		template <> struct UniformType<float> { constexpr static GLenum value = GL_FLOAT; };
+		template <> struct UniformType<glm::ivec4> { constexpr static GLenum value = GL_INT_VEC4; };
+		template <> struct UniformType<glm::ivec3> { constexpr static GLenum value = GL_INT_VEC3; };
+		template <> struct UniformType<glm::ivec2> { constexpr static GLenum value = GL_INT_VEC2; };
+		template <> struct UniformType<int> { constexpr static GLenum value = GL_INT; };
+		template <> struct UniformType<glm::uvec4> { constexpr static GLenum value = GL_UNSIGNED_INT_VEC4; };
+		template <> struct UniformType<glm::uvec3> { constexpr static GLenum value = GL_UNSIGNED_INT_VEC3; };
+		template <> struct UniformType<glm::uvec2> { constexpr static GLenum value = GL_UNSIGNED_INT_VEC2; };
+		template <> struct UniformType<uint32_t> { constexpr static GLenum value = GL_UNSIGNED_INT; };
+	}
+	/**
+	 * @brief Last values uploaded to the uniforms of a program
+	 *
+	 * Setting a uniform to the value it already has is skipped after a memcmp with the shadow copy.
+	 * Values bigger than a mat4 are not shadowed. If foreign code sets uniforms of the program, clear the shadow.
+	 */
+	class UniformShadow
+	{
+	public:
+		DECL_PTR(UniformShadow)
+		/// Upload counters
+		struct Stats
+		{
+			/// Uploads skipped, the value didn't change
+			uint64_t hits = 0;
+			/// Uploads done
+			uint64_t misses = 0;
+		};
+		/// Biggest shadowed value, in bytes
+		constexpr static size_t MaxSize = 64;
+		/**
+		 * @brief Record a value
+		 * @return true if the value must be uploaded (it changed or isn't shadowed)
+		 */
+		bool update(GLint location, const void* value, size_t size);
+		/// Forget every value, to call when the uniforms are reset (link) or set by foreign code
+		void clear();
+		const Stats& stats() const
+		{
+			return m_stats;
+		}
+		void resetStats()
+		{
+			m_stats = Stats();
+		}
+	private:
+		struct Value
+		{
+			unsigned char bytes[MaxSize];
+			size_t size = 0;
+		};
+		std::unordered_map<GLint, Value> m_values;
+		Stats m_stats;
+	};
 	template <class Type>
 	class Uniform
 	{
 	public:
 		DECL_PTR(Uniform)
-		Uniform(std::string name) : m_name(name)
+		Uniform(std::string name) : m_name(name), m_hash(UniformName::Hash(m_name.c_str()))
 		{}
 		const std::string& name() const
 		{
 			return m_name;
 		}
+		/// Name with its hash, to look up the location cache of a program
+		UniformName uniformName() const
+		{
+			return UniformName(m_name.c_str(), m_hash);
+		}
+		/// Upload the value in *shader*. The location comes from the cache of the program.
 		void use(const gl::sl::Program& shader) const;
 		virtual const Type* instance() const = 0;
 	private:
 		std::string m_name;
+		uint32_t m_hash;
 	};
 	template <class Type>
 	class UniformRef : public Uniform<Type>
@@ -640,6 +1639,49 @@ namespace gl
 	private:
 		Type m_instance;
 	};
+	/**
+	 * @brief Uniform resolved in advance
+	 *
+	 * Holds the program and the location, so setting the value does no string work and no allocation.
+	 * Get one from gl::sl::Program::uniformHandle, and get a new one after linking the program again.
+	 * ```cpp
+	 * auto modelmat = program.uniformHandle<glm::mat4>("modelmat");
+	 * // each frame
+	 * modelmat.set(matrix);
+	 * ```
+	 */
+	template <class Type>
+	class UniformHandle
+	{
+	public:
+		UniformHandle() = default;
+		/// @param shadow Shadow of the program, to skip uploads of the current value (nullptr to always upload)
+		UniformHandle(GLuint program, GLint location, UniformShadow::sptr shadow = nullptr) : m_program(program), m_location(location), m_shadow(std::move(shadow))
+		{}
+		/// Set the value of the uniform. Skipped if the program already has this value.
+		void set(const Type& value) const
+		{
+			if (!m_shadow || m_shadow->update(m_location, &value, sizeof(Type)))
+				detail::upload(m_program, m_location, value);
+		}
+		GLuint program() const
+		{
+			return m_program;
+		}
+		GLint location() const
+		{
+			return m_location;
+		}
+		/// False if the uniform doesn't exist (or is unused) in the program
+		bool valid() const
+		{
+			return m_location != -1;
+		}
+	private:
+		GLuint m_program = 0;
+		GLint m_location = -1;
+		UniformShadow::sptr m_shadow;
+	};
 	class Sampler : public Object
 	{
 	public:
@@ -701,6 +1743,11 @@ namespace gl
 		virtual void destroy();
 	};
 
+	/// Size in bytes of a pixel of *format* and *type*, as given to glTexSubImage2D or glReadPixels
+	GLsizeiptr pixelSize(GLenum format, GLenum type);
+	/// Size in bytes of the rows of an image, each one padded to *alignment* (GL_UNPACK_ALIGNMENT, GL_PACK_ALIGNMENT)
+	GLsizeiptr rowPitch(GLenum format, GLenum type, GLsizei width, GLint alignment = 4);
+
 	class Texture : public Object
 	{
 	public:
@@ -732,17 +1779,69 @@ namespace gl
 		const Sampler& getSampler() const;
 		Sampler& getSampler();
 
+		/// Allocate the texture without data. Nothing is done if the size and format didn't change.
+		/// Storage stays mutable, also with DSA, so the texture keeps its name when resized. Throws on a texture given immutable storage by allocate.
 		void init_null(GLenum format=GL_RGBA, GLenum type=GL_UNSIGNED_BYTE);
+		/// Set the whole level 0.
+		/// When the size and the format didn't change, the storage is kept and only the pixels are updated (glTexSubImage2D).
+		/// Otherwise the storage is reallocated in place (glTexImage2D), throws if it's immutable.
 		void load(GLenum format, GLenum type, const GLvoid * data, glm::vec2 newsize = glm::vec2(-1));
+		/**
+		 * @brief Set the whole level 0 with block compressed data
+		 *
+		 * Like load, the storage is kept when the size and the format didn't change, and reallocated in place otherwise (throws if it's immutable).
+		 * @param internalFormat Compressed format of the data (GL_COMPRESSED_RGBA_S3TC_DXT5_EXT...), see BlockCompressor
+		 * @param imageSize Size of the data in bytes
+		 * @see [glCompressedTexImage2D](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glCompressedTexImage2D.xhtml)
+		 */
+		void loadCompressed(GLenum internalFormat, const GLvoid * data, GLsizei imageSize, glm::ivec2 newsize = glm::ivec2(-1));
+		/**
+		 * @brief Allocate immutable storage
+		 *
+		 * Size and format can't change afterwards : allocating again creates a new texture name.
+		 * @param levels Mipmap levels, 0 for a full chain
+		 * @param internalFormat Sized internal format (GL_RGBA8...)
+		 * @see [glTexStorage2D](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glTexStorage2D.xhtml)
+		 */
+		void allocate(GLsizei levels, GLenum internalFormat, glm::ivec2 size);
+		/// Allocate immutable storage for array, 3D and cube map array targets, *size.z* being the depth or layer count.
+		/// @see [glTexStorage3D](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glTexStorage3D.xhtml)
+		void allocate(GLsizei levels, GLenum internalFormat, glm::ivec3 size);
+		/**
+		 * @brief Set the pixels of a region of a level, without reallocating
+		 *
+		 * @param offset Position of the region in the level
+		 * @param size Size of the region in pixels
+		 * @see [glTexSubImage2D](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glTexSubImage2D.xhtml)
+		 */
+		void update(GLint level, glm::ivec2 offset, glm::ivec2 size, GLenum format, GLenum type, const GLvoid * data);
+		/// @see [glTexSubImage3D](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glTexSubImage3D.xhtml)
+		void update(GLint level, glm::ivec3 offset, glm::ivec3 size, GLenum format, GLenum type, const GLvoid * data);
+		/// Mipmap levels of the storage, 0 if not allocated
+		GLsizei getLevels() const;
+		/// True if allocated with immutable storage
+		bool isImmutable() const;
 		void generateMipmap();
 	protected:
 		
 		virtual void destroy();
 	private:
+		/// Allocate immutable storage for the current size, depth and format
+		void createStorage(GLsizei levels);
+		/// True if the storage matches the current size and format
+		bool isAllocated() const;
 		glm::ivec2 m_size;
 		GLenum m_format;
 		GLenum m_target;
 		Sampler m_sampler;
+		/// Depth or layers of the 3D and array targets
+		GLsizei m_depth = 1;
+		/// Storage description, m_levels is 0 without storage
+		GLsizei m_levels = 0;
+		bool m_immutable = false;
+		glm::ivec2 m_storageSize;
+		GLsizei m_storageDepth = 1;
+		GLenum m_storageFormat = 0;
 	};
 	
 	class RenderBuffer : public Object
@@ -757,8 +1856,12 @@ namespace gl
 			instantiate();
 			if (newsize.x != -1 && newsize.y != -1)
 				setSize(newsize);
+#if LIBGLW_WITH_DSA
+			glNamedRenderbufferStorageMultisample(id(), multisample, internalformat, m_size.x, m_size.y);
+#else
 			bind();
 			glRenderbufferStorageMultisample(GL_RENDERBUFFER, multisample, internalformat, m_size.x, m_size.y);
+#endif
 		}
 		void setSize(glm::ivec2 size);
 		glm::ivec2 getSize();
@@ -801,6 +1904,42 @@ namespace gl
 			AttachStencil = GL_STENCIL_ATTACHMENT,
 			AttachDepthStencil = GL_DEPTH_STENCIL_ATTACHMENT
 		};
+	private:
+		struct ReadbackSlot;
+	public:
+		/**
+		 * @brief Pixels read by readAsync
+		 *
+		 * The GPU writes them in a pixel pack buffer : ready() tells without blocking when they can be read.
+		 * The handle stays valid until its buffer of the ring is used again by another readAsync.
+		 */
+		class Readback
+		{
+		public:
+			Readback() = default;
+			/// False if the buffer has been reused by a later readAsync
+			bool valid() const;
+			/// True once the pixels are in the buffer. Never blocks.
+			bool ready();
+			/// Wait for the pixels, false if the timeout (in nanoseconds) expired
+			bool wait(GLuint64 timeout = GL_TIMEOUT_IGNORED);
+			/// Map the pixels for reading, waiting for them if needed. Rows are rowPitch() bytes apart.
+			const unsigned char* data();
+			/// Size in bytes of the pixels
+			GLsizeiptr size() const;
+			/// Bytes between two rows (rows are 4 bytes aligned, like GL_PACK_ALIGNMENT)
+			GLsizeiptr rowPitch() const;
+			/// Size of the read rectangle in pixels
+			glm::ivec2 extent() const;
+		private:
+			friend class Framebuffer;
+			Readback(std::shared_ptr<ReadbackSlot> slot, uint64_t generation) : m_slot(std::move(slot)), m_generation(generation)
+			{}
+			/// Slot of the ring, throws if reused
+			ReadbackSlot& slot() const;
+			std::shared_ptr<ReadbackSlot> m_slot;
+			uint64_t m_generation = 0;
+		};
 		Framebuffer();
 		virtual void instantiate();
 		~Framebuffer();
@@ -819,6 +1958,34 @@ namespace gl
 		GLenum getStatus();
 
 		void clear(GLuint flags = ClearColor);
+		/// Clear a color attachment without touching the clear color state.
+		/// @see [glClearBuffer](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glClearBuffer.xhtml)
+		void clearColor(glm::vec4 color, GLint drawbuffer = 0);
+		/// Clear the depth attachment without touching the clear depth state.
+		void clearDepth(float depth = 1.f);
+		/// Clear the stencil attachment without touching the clear stencil state.
+		void clearStencil(GLint stencil = 0);
+		/**
+		 * @brief Read pixels without waiting for the GPU
+		 *
+		 * glReadPixels writes into the next pixel pack buffer of a ring and a fence is placed after it : the call returns at once,
+		 * and the next frames can be rendered while the pixels are in flight. Reusing a buffer of the ring waits for its previous read,
+		 * so keep at least as many buffers (setReadbackBuffers) as frames in flight.
+		 * ```cpp
+		 * pending.push_back(fbo.readAsync(gl::Framebuffer::AttachColor0, glm::ivec4(0, 0, width, height), GL_RGBA, GL_UNSIGNED_BYTE));
+		 * if (pending.front().ready())
+		 *     save(pending.front().data());
+		 * ```
+		 * @param rect x, y, width, height
+		 * @see [glReadPixels](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glReadPixels.xhtml)
+		 */
+		Readback readAsync(Attachment attachment, glm::ivec4 rect, GLenum format, GLenum type);
+		/// Size of the ring of pixel pack buffers used by readAsync (3 by default)
+		void setReadbackBuffers(size_t count);
+		size_t readbackBuffers() const
+		{
+			return m_readbacks.size();
+		}
 		
 	protected:
 		virtual void destroy();
@@ -826,5 +1993,20 @@ namespace gl
 		glm::ivec2 m_size;
 		
 		std::map<GLenum, RenderBuffer> m_attachments;
+	private:
+		/// Buffer of the readback ring, shared with the Readback handles
+		struct ReadbackSlot
+		{
+			PixelPackBuffer buffer;
+			PixelPackBuffer::Mapping mapping;
+			Fence fence;
+			/// Incremented by each read in the buffer
+			uint64_t generation = 0;
+			GLsizeiptr size = 0;
+			GLsizeiptr rowPitch = 0;
+			glm::ivec2 extent;
+		};
+		std::vector<std::shared_ptr<ReadbackSlot>> m_readbacks = std::vector<std::shared_ptr<ReadbackSlot>>(3);
+		size_t m_readback = 0;
 	};
 }
\ No newline at end of file
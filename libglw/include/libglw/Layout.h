@@ -0,0 +1,207 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+
+namespace gl
+{
+	/**
+	 * @brief Memory layout of interface blocks
+	 *
+	 * The GLSL rules std140 (uniform blocks) and std430 (storage blocks) align members very differently from C++ :
+	 * a vec3 takes 16 bytes in an array, mat3 columns are padded to vec4... A C++ struct mirroring a block silently
+	 * gets wrong offsets.
+	 * Block computes the offsets of its members at compile time and packs them in the right place.
+	 */
+	namespace layout
+	{
+		enum class Rule
+		{
+			Std140,
+			Std430
+		};
+		constexpr std::size_t roundUp(std::size_t value, std::size_t alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+		/**
+		 * @brief Base alignment and size of a block member
+		 *
+		 * Specialized for 32 bit scalars, glm vectors and matrices, std::array and nested Block.
+		 * write copies the value at its place, with the padding of the rule.
+		 */
+		template <Rule rule, typename T, typename = void>
+		struct Traits;
+
+		template <Rule rule, typename T>
+		struct Traits<rule, T, std::enable_if_t<std::is_arithmetic<T>::value>>
+		{
+			static_assert(sizeof(T) == 4, "gl::layout block scalars are 32 bit (use int or uint32_t for bool)");
+			constexpr static std::size_t align = 4;
+			constexpr static std::size_t size = 4;
+			static void write(unsigned char* dst, const T& value)
+			{
+				std::memcpy(dst, &value, size);
+			}
+		};
+		/// Vector of *N* 32 bit components : vec3 is aligned like vec4
+		template <std::size_t N>
+		struct VectorTraits
+		{
+			constexpr static std::size_t align = N == 1 ? 4 : N == 2 ? 8 : 16;
+			constexpr static std::size_t size = N * 4;
+			template <typename T>
+			static void write(unsigned char* dst, const T& value)
+			{
+				static_assert(sizeof(T) == size, "gl::layout vector components are 32 bit");
+				std::memcpy(dst, &value, size);
+			}
+		};
+		/// Column major matrix, stored like an array of *C* columns
+		template <Rule rule, std::size_t C, std::size_t R>
+		struct MatrixTraits
+		{
+			constexpr static std::size_t stride = rule == Rule::Std140 ? roundUp(VectorTraits<R>::align, 16) : VectorTraits<R>::align;
+			constexpr static std::size_t align = stride;
+			constexpr static std::size_t size = C * stride;
+			template <typename T>
+			static void write(unsigned char* dst, const T& value)
+			{
+				static_assert(sizeof(T) == C * R * 4, "gl::layout matrix components are 32 bit");
+				const unsigned char* src = reinterpret_cast<const unsigned char*>(&value);
+				for (std::size_t c = 0; c < C; ++c)
+					std::memcpy(dst + c * stride, src + c * R * 4, R * 4);
+			}
+		};
+		template <Rule rule> struct Traits<rule, glm::vec2> : VectorTraits<2> {};
+		template <Rule rule> struct Traits<rule, glm::vec3> : VectorTraits<3> {};
+		template <Rule rule> struct Traits<rule, glm::vec4> : VectorTraits<4> {};
+		template <Rule rule> struct Traits<rule, glm::ivec2> : VectorTraits<2> {};
+		template <Rule rule> struct Traits<rule, glm::ivec3> : VectorTraits<3> {};
+		template <Rule rule> struct Traits<rule, glm::ivec4> : VectorTraits<4> {};
+		template <Rule rule> struct Traits<rule, glm::uvec2> : VectorTraits<2> {};
+		template <Rule rule> struct Traits<rule, glm::uvec3> : VectorTraits<3> {};
+		template <Rule rule> struct Traits<rule, glm::uvec4> : VectorTraits<4> {};
+		template <Rule rule> struct Traits<rule, glm::mat2> : MatrixTraits<rule, 2, 2> {};
+		template <Rule rule> struct Traits<rule, glm::mat3> : MatrixTraits<rule, 3, 3> {};
+		template <Rule rule> struct Traits<rule, glm::mat4> : MatrixTraits<rule, 4, 4> {};
+		/// Array : with std140, elements are padded to 16 bytes
+		template <Rule rule, typename T, std::size_t N>
+		struct Traits<rule, std::array<T, N>>
+		{
+			constexpr static std::size_t align = rule == Rule::Std140 ? roundUp(Traits<rule, T>::align, 16) : Traits<rule, T>::align;
+			constexpr static std::size_t stride = roundUp(Traits<rule, T>::size, align);
+			constexpr static std::size_t size = N * stride;
+			static void write(unsigned char* dst, const std::array<T, N>& value)
+			{
+				for (std::size_t i = 0; i < N; ++i)
+					Traits<rule, T>::write(dst + i * stride, value[i]);
+			}
+		};
+
+		/// Offsets of consecutive members, in bytes
+		template <Rule rule, typename ...Types>
+		constexpr std::array<std::size_t, sizeof...(Types)> offsets()
+		{
+			const std::size_t aligns[] = {Traits<rule, Types>::align...};
+			const std::size_t sizes[] = {Traits<rule, Types>::size...};
+			std::array<std::size_t, sizeof...(Types)> result{};
+			std::size_t offset = 0;
+			for (std::size_t i = 0; i < sizeof...(Types); ++i)
+			{
+				offset = roundUp(offset, aligns[i]);
+				result[i] = offset;
+				offset += sizes[i];
+			}
+			return result;
+		}
+
+		/**
+		 * @brief Block packed with a layout rule
+		 *
+		 * Members are described by their types, in the order of the GLSL declaration, and accessed by index :
+		 * ```cpp
+		 * // layout(std140) uniform Object { mat4 model; vec3 color; float alpha; };
+		 * gl::Std140<glm::mat4, glm::vec3, float> object;
+		 * object.set<0>(model);
+		 * object.set<1>(color);
+		 * object.set<2>(alpha);
+		 * ```
+		 * A Block is trivially copyable and can be the *MyStruct* of a UniformBuffer or a DynamicUniformBuffer.
+		 *
+		 * Offsets are compile time constants, so a handwritten struct can be checked against the rule :
+		 * ```cpp
+		 * static_assert(offsetof(Object, alpha) == gl::Std140<glm::mat4, glm::vec3, float>::offset<2>());
+		 * ```
+		 */
+		template <Rule rule, typename ...Types>
+		class Block
+		{
+		public:
+			static_assert(sizeof...(Types) > 0, "gl::layout::Block needs at least one member");
+			constexpr static std::size_t Count = sizeof...(Types);
+			/// Base alignment of the block : with std140, rounded up to a vec4
+			constexpr static std::size_t Alignment = rule == Rule::Std140 ? roundUp(std::max({Traits<rule, Types>::align...}), 16) : std::max({Traits<rule, Types>::align...});
+			template <std::size_t I>
+			using Type = std::tuple_element_t<I, std::tuple<Types...>>;
+
+			/// Offset of the member *I* in bytes
+			template <std::size_t I>
+			constexpr static std::size_t offset()
+			{
+				return Offsets[I];
+			}
+			/// Size of the block in bytes, padded to its alignment
+			constexpr static std::size_t size()
+			{
+				return Size;
+			}
+			template <std::size_t I>
+			void set(const Type<I>& value)
+			{
+				Traits<rule, Type<I>>::write(m_data + Offsets[I], value);
+			}
+			/// Set every member, in order
+			void set(const Types&... values)
+			{
+				setAll(std::index_sequence_for<Types...>(), values...);
+			}
+			const unsigned char* data() const
+			{
+				return m_data;
+			}
+		private:
+			template <std::size_t ...I>
+			void setAll(std::index_sequence<I...>, const Types&... values)
+			{
+				(set<I>(values), ...);
+			}
+			constexpr static std::array<std::size_t, Count> Offsets = offsets<rule, Types...>();
+			constexpr static std::size_t Size = roundUp(Offsets[Count - 1] + Traits<rule, Type<Count - 1>>::size, Alignment);
+
+			alignas(16) unsigned char m_data[Size] = {};
+		};
+		/// Nested block : a GLSL struct member
+		template <Rule rule, Rule inner, typename ...Types>
+		struct Traits<rule, Block<inner, Types...>>
+		{
+			static_assert(rule == inner, "gl::layout nested block must use the rule of its parent");
+			constexpr static std::size_t align = Block<inner, Types...>::Alignment;
+			constexpr static std::size_t size = Block<inner, Types...>::size();
+			static void write(unsigned char* dst, const Block<inner, Types...>& value)
+			{
+				std::memcpy(dst, value.data(), size);
+			}
+		};
+	}
+	/// Block with the layout of `layout(std140) uniform`
+	template <typename ...Types>
+	using Std140 = layout::Block<layout::Rule::Std140, Types...>;
+	/// Block with the layout of `layout(std430) buffer`
+	template <typename ...Types>
+	using Std430 = layout::Block<layout::Rule::Std430, Types...>;
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <GL/glew.h>
+#include <functional>
+#include <map>
+#include <vector>
+#include "config.h"
+
+namespace gl
+{
+	/**
+	 * @brief Batched generation and deletion of object names
+	 *
+	 * Names are generated by blocks (one glGen* call for *block size* names) and handed out from a free list.
+	 * Released names are deleted by batches (one glDelete* call once *block size* names are released, or on flush).
+	 *
+	 * A released name is never handed out again : it still carries the state of its previous object.
+	 * It stays alive until its batch is deleted, so call flush at the end of a frame or of a loading step
+	 * to give back the memory of released objects.
+	 */
+	class NamePool
+	{
+	public:
+		/// Generate *count* names, like glGen*
+		using Generator = std::function<void(GLsizei count, GLuint* names)>;
+		/// Delete *count* names, like glDelete*
+		using Deleter = std::function<void(GLsizei count, const GLuint* names)>;
+
+		NamePool(Generator generator, Deleter deleter, GLsizei block_size = 32);
+		NamePool(const NamePool&) = delete;
+		NamePool& operator=(const NamePool&) = delete;
+
+		/// Take a name, generating a new block if the free list is empty.
+		GLuint acquire();
+		/// Give back a name. It's deleted with the next batch. 0 is ignored.
+		void release(GLuint name);
+		/// Generate names in advance so that the next *count* acquire don't call the driver.
+		void reserve(GLsizei count);
+		/// Delete the released names now.
+		void flush();
+		/// Delete the released and the free names. Call it before destroying the context.
+		void clear();
+
+		void setBlockSize(GLsizei block_size);
+		GLsizei blockSize() const
+		{
+			return m_blockSize;
+		}
+		/// Names generated and not handed out yet
+		GLsizei available() const
+		{
+			return static_cast<GLsizei>(m_free.size());
+		}
+		/// Names released and not deleted yet
+		GLsizei pending() const
+		{
+			return static_cast<GLsizei>(m_released.size());
+		}
+	private:
+		Generator m_generator;
+		Deleter m_deleter;
+		GLsizei m_blockSize;
+		std::vector<GLuint> m_free;
+		std::vector<GLuint> m_released;
+	};
+	/**
+	 * @brief Name pools of a context
+	 *
+	 * One pool per kind of object, and one per target for textures created with DSA (glCreateTextures needs the target).
+	 * Objects of libglw take their names from the pools of the current thread. Like StateCache, switch them with MakeCurrent
+	 * when switching context on a thread.
+	 *
+	 * Bulk creation only needs a reserve before creating the objects :
+	 * ```cpp
+	 * gl::NamePools::Current().textures(GL_TEXTURE_2D).reserve(512);
+	 * ```
+	 */
+	class NamePools
+	{
+	public:
+		NamePools();
+		NamePools(const NamePools&) = delete;
+		NamePools& operator=(const NamePools&) = delete;
+		/// Pools of the current thread.
+		static NamePools& Current();
+		/// Set the pools of the current thread, nullptr to get back the default ones.
+		static void MakeCurrent(NamePools* pools);
+
+		/// Pool of textures. Without DSA, every target shares the same pool.
+		NamePool& textures(GLenum target);
+		/// Delete the released names of every pool.
+		void flush();
+		/// Delete every name of every pool. Call it before destroying the context.
+		void clear();
+
+		NamePool buffers;
+		NamePool vertexArrays;
+		NamePool samplers;
+		NamePool framebuffers;
+		NamePool renderbuffers;
+		NamePool programPipelines;
+	private:
+		std::map<GLenum, NamePool> m_textures;
+	};
+}
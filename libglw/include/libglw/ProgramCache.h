@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Shaders.h"
+
+namespace gl
+{
+	namespace sl
+	{
+		/**
+		 * @brief On-disk cache of linked programs
+		 *
+		 * Programs are built from their sources the first time, then the binary of the driver (glGetProgramBinary) is saved
+		 * in *directory*. Next runs load it back with glProgramBinary and skip the GLSL compiler.
+		 *
+		 * A binary is keyed by a hash of the sources, their stage, the defines and the vendor/renderer/version strings of the driver :
+		 * editing a shader or updating the driver builds the program again. A binary rejected by the driver is deleted and the program
+		 * is built from sources, so the cache never fails where a plain build works.
+		 * ```cpp
+		 * gl::sl::ProgramCache cache("cache/shaders");
+		 * gl::sl::Program program;
+		 * cache.build(program, {{gl::sl::Vertex, vertSource}, {gl::sl::Fragment, fragSource}}, {"USE_SHADOWS", "LIGHTS 4"});
+		 * ```
+		 * Needs OpenGL 4.1 or ARB_get_program_binary, and a driver exposing at least one binary format. Otherwise build always compiles.
+		 */
+		class ProgramCache
+		{
+		public:
+			DECL_PTR(ProgramCache)
+			using Source = ShaderSource;
+			struct Stats
+			{
+				/// Programs loaded from a binary
+				uint64_t hits = 0;
+				/// Programs built from sources
+				uint64_t misses = 0;
+				/// Binaries the driver didn't accept
+				uint64_t rejected = 0;
+			};
+			/// The directory must exist (it's created with LIBGLW_WITH_STD_FILESYSTEM).
+			explicit ProgramCache(std::string directory);
+
+			/**
+			 * @brief Insert defines after the #version line
+			 *
+			 * Each define is a name optionally followed by its value ("LIGHTS 4"). A #line directive keeps the line numbers of the
+			 * compile errors matching the original source.
+			 */
+			static std::string InjectDefines(const std::string& code, const std::vector<std::string>& defines);
+
+			/**
+			 * @brief Load a program from the cache, or build it and store its binary
+			 *
+			 * Compile and link errors throw like Shader and Program::link.
+			 * @param defines injected in every stage, see InjectDefines
+			 */
+			void build(Program& program, const std::vector<Source>& sources, const std::vector<std::string>& defines = {});
+			/// Key of the binary of a program
+			uint64_t key(const std::vector<Source>& sources, const std::vector<std::string>& defines = {});
+
+			/// Disabled, build always compiles and nothing is written.
+			void setEnabled(bool enabled)
+			{
+				m_enabled = enabled;
+			}
+			bool enabled() const
+			{
+				return m_enabled;
+			}
+			const std::string& directory() const
+			{
+				return m_directory;
+			}
+			const Stats& stats() const
+			{
+				return m_stats;
+			}
+			void resetStats()
+			{
+				m_stats = Stats();
+			}
+		private:
+			/// True if the driver can give binaries. Queried on first use, with the driver strings.
+			bool supported();
+			std::string path(uint64_t key) const;
+			bool load(Program& program, uint64_t key);
+			void store(const Program& program, uint64_t key) const;
+
+			std::string m_directory;
+			/// Vendor, renderer and version of the driver
+			std::string m_driver;
+			bool m_queried = false;
+			bool m_supported = false;
+			bool m_enabled = true;
+			Stats m_stats;
+		};
+	}
+}
@@ -0,0 +1,140 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Shaders.h"
+
+namespace gl
+{
+	namespace sl
+	{
+		/**
+		 * @brief Permutations of a program, built on first use
+		 *
+		 * The keys of the variants are flags (a define set or not) and choices (one define among several). Each key takes bits
+		 * of a mask, which identifies a variant. get(mask) injects the defines of the mask after the #version line of each stage
+		 * (see ProgramCache::InjectDefines), then compiles and links the variant the first time it's asked.
+		 *
+		 * A key whose define names don't appear in the source of a stage doesn't change that stage : its shader is compiled once
+		 * and attached to every variant which differs only by such keys. Shaders are also shared between the managers of a context
+		 * (of a thread) : a stage whose source, once the defines are injected, is identical to one already compiled reuses its shader.
+		 * ```cpp
+		 * gl::sl::ShaderVariants variants({{gl::sl::Vertex, vert}, {gl::sl::Fragment, frag}}, "mesh");
+		 * auto skinning = variants.addFlag("SKINNING");
+		 * auto fog = variants.addChoice({"FOG_NONE", "FOG_LINEAR", "FOG_EXP"});
+		 * variants.get(skinning | fog(2)).use();
+		 * ```
+		 * Compile and link errors throw like Shader and Program::link, and the variant is tried again on the next get.
+		 */
+		class ShaderVariants
+		{
+		public:
+			DECL_PTR(ShaderVariants)
+			using Source = ShaderSource;
+			using Mask = uint64_t;
+			/// Key taking one value among several, see addChoice
+			class Choice
+			{
+			public:
+				/// Bits of the mask selecting the *value*-th define
+				Mask operator()(size_t value) const
+				{
+					if (value >= m_count)
+						throw std::runtime_error("gl::sl::ShaderVariants::Choice value out of range");
+					return static_cast<Mask>(value) << m_shift;
+				}
+				size_t count() const
+				{
+					return m_count;
+				}
+			private:
+				friend class ShaderVariants;
+				Choice(unsigned shift, size_t count) : m_shift(shift), m_count(count)
+				{}
+				unsigned m_shift;
+				size_t m_count;
+			};
+			struct Stats
+			{
+				/// Variants linked
+				uint64_t programs = 0;
+				/// Shaders compiled
+				uint64_t compiles = 0;
+				/// Shaders reused from another variant or another manager
+				uint64_t shared = 0;
+			};
+			/// @param name shown in the compile errors
+			explicit ShaderVariants(std::vector<Source> sources, std::string name = "");
+			ShaderVariants(const ShaderVariants&) = delete;
+			ShaderVariants& operator=(const ShaderVariants&) = delete;
+			/// Release the shaders. The variants are destroyed with the manager.
+			~ShaderVariants();
+
+			/// Add a key defining *define* when its bit is set. Returns the bit.
+			Mask addFlag(std::string define);
+			/**
+			 * @brief Add a key defining one of *defines*
+			 *
+			 * The first define is the default one, selected by the bits set to 0.
+			 */
+			Choice addChoice(std::vector<std::string> defines);
+			/// Defines of a variant, throws if the mask has unknown bits
+			std::vector<std::string> defines(Mask mask) const;
+			/// Program of a variant, compiled and linked the first time
+			Program& get(Mask mask);
+			/// True if the variant has already been built
+			bool built(Mask mask) const
+			{
+				return m_programs.count(mask) != 0;
+			}
+			/// Number of variants built
+			size_t size() const
+			{
+				return m_programs.size();
+			}
+			/// Destroy the variants and their shaders. The keys are kept.
+			void clear();
+
+			const Stats& stats() const
+			{
+				return m_stats;
+			}
+		private:
+			struct Key
+			{
+				std::vector<std::string> defines;
+				unsigned shift;
+				unsigned bits;
+				/// Defined only when its bit is set
+				bool flag;
+				/// Mask of the bits of the key
+				Mask mask() const
+				{
+					return ((Mask(1) << bits) - 1) << shift;
+				}
+			};
+			struct Stage
+			{
+				Source source;
+				/// Bits of the keys used by the stage
+				Mask used = 0;
+				/// Compiled shaders by mask of used bits
+				std::unordered_map<Mask, GLuint> shaders;
+			};
+			/// Reserve the bits of a key
+			Mask addKey(std::vector<std::string> defines, unsigned bits, bool flag);
+			/// Shader of a stage for a variant, compiled if needed
+			GLuint shader(Stage& stage, Mask mask);
+
+			std::string m_name;
+			std::vector<Stage> m_stages;
+			std::vector<Key> m_keys;
+			/// Bits used by the keys
+			unsigned m_bits = 0;
+			std::unordered_map<Mask, std::unique_ptr<Program>> m_programs;
+			Stats m_stats;
+		};
+	}
+}
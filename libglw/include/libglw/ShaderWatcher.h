@@ -0,0 +1,125 @@
+#pragma once
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Shaders.h"
+
+namespace gl
+{
+	namespace sl
+	{
+		/**
+		 * @brief Hot reload of the programs built from files
+		 *
+		 * When a watcher is current (MakeCurrent), every Program linked from shader files (Shader(path), Program::load, Collection)
+		 * is registered with its stages and the files they include (see SourceLoader). poll(), called once per frame on the GL thread,
+		 * looks for modified files (inotify on Linux, modification times elsewhere) and rebuilds only the dependent programs :
+		 * the stages including a modified file are compiled again, the other ones are reused, then a new program is linked.
+		 *
+		 * A failed compile or link keeps the last good program : the error goes to the listener and the renderer goes on.
+		 * On success the Program takes the name of the new one, so its uniform locations and values must be set again
+		 * (the listener is the place to do it). Attribute locations set with setAttribLocation are not kept : use layout qualifiers.
+		 * The separable and binary retrievable parameters of the previous program are kept.
+		 * References to a reloaded Program (copies, AsyncCompiler jobs) keep the previous name, alive until the last of them is destroyed,
+		 * and so do the UniformHandles. A ProgramPipeline keeps the previous stages : call useStages again from the listener.
+		 * ```cpp
+		 * gl::sl::ShaderWatcher watcher;
+		 * gl::sl::ShaderWatcher::MakeCurrent(&watcher);
+		 * program.load("shaders/effect"); // watched
+		 * // each frame
+		 * watcher.poll();
+		 * ```
+		 */
+		class ShaderWatcher
+		{
+		public:
+			/// Called after each reload, with the error log if it failed (empty on success)
+			using Listener = std::function<void(Program& program, const std::string& error)>;
+			struct Stats
+			{
+				/// Programs rebuilt
+				uint64_t reloads = 0;
+				/// Rebuilds which failed, the previous program being kept
+				uint64_t failures = 0;
+				/// Shaders compiled again
+				uint64_t compiles = 0;
+			};
+			ShaderWatcher();
+			ShaderWatcher(const ShaderWatcher&) = delete;
+			ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+			/// Stop watching the programs. Their current names stay valid.
+			~ShaderWatcher();
+
+			/// Watcher of the current thread, which registers the programs on link. nullptr by default.
+			static ShaderWatcher* Current();
+			static void MakeCurrent(ShaderWatcher* watcher);
+
+			/// Watch the files a program has been linked from. Done by Program::link when the watcher is current.
+			void watch(Program& program);
+			void unwatch(Program& program);
+			/**
+			 * @brief Rebuild the programs depending on modified files
+			 *
+			 * @return how many programs have been rebuilt successfully
+			 */
+			size_t poll();
+
+			void setListener(Listener listener)
+			{
+				m_listener = std::move(listener);
+			}
+			/// Error of the last failed rebuild
+			const std::string& lastError() const
+			{
+				return m_lastError;
+			}
+			const Stats& stats() const
+			{
+				return m_stats;
+			}
+			/// How many programs are watched
+			size_t watched() const
+			{
+				return m_programs.size();
+			}
+			/// Called by Program::swap : the programs exchanged their registrations
+			void swapped(Program& first, Program& second);
+		private:
+			struct Stage
+			{
+				TypeShader type = Vertex;
+				std::string path;
+				/// Compiled by the watcher, 0 until the first rebuild
+				GLuint shader = 0;
+				/// Files of the stage, with its includes
+				std::vector<std::string> files;
+			};
+			/// Rebuild a program, true on success
+			bool reload(Program& program, std::vector<Stage>& stages, const std::set<std::string>& changed);
+			/// Register the files of the stages in the dependency graph
+			void addDependencies(Program& program, const std::vector<Stage>& stages);
+			void removeDependencies(Program& program, const std::vector<Stage>& stages);
+			/// Watch the directory of a file
+			void watchFile(const std::string& path);
+			/// Files modified since the last call
+			std::set<std::string> changes();
+			static void releaseShaders(std::vector<Stage>& stages);
+
+			std::unordered_map<Program*, std::vector<Stage>> m_programs;
+			/// Programs depending on each file
+			std::unordered_map<std::string, std::set<Program*>> m_dependents;
+			/// inotify descriptor, -1 without inotify
+			int m_notify = -1;
+			/// Watched directories by inotify watch descriptor
+			std::map<int, std::string> m_directories;
+			/// Modification times of the files, without inotify
+			std::unordered_map<std::string, int64_t> m_times;
+			Listener m_listener;
+			std::string m_lastError;
+			Stats m_stats;
+		};
+	}
+}
@@ -8,11 +8,13 @@
 #include <memory>
 #include <array>
 #include <vector>
+#include <unordered_map>
 #include <iostream>
 #include <sstream>
 #include <fstream>
 //#include "GLC_Object.h"
 #include "GLClass.h"
+#include "SourceLoader.h"
 #include "config.h"
 
 namespace gl
@@ -61,7 +63,7 @@ namespace gl
 #endif
 			Shader(Shader&& shad) : Object(std::move(shad))
 			{
-				std::swap(type, shad.type);
+				std::swap(m_path, shad.m_path);
 			}
 			~Shader()
 			{
@@ -78,25 +80,24 @@ namespace gl
 				instantiate();
 				if (id() == 0)
 					throw std::runtime_error("gl::sl::Shader : type inconnu");
+				if (isFile)
+					m_path = input;
+				else
+					m_path.clear();
 
 				std::string codeSource;
 				if (isFile)
 				{
-					std::ostringstream ostrSource;
-					std::string ligneCodeSource;
-					std::ifstream fichierSource(input);
-					// Test de l'ouverture
-
-					if (!fichierSource)
+					// Read once and cached with its includes, see SourceLoader
+					try
+					{
+						codeSource = SourceLoader::Global().load(input);
+					}
+					catch (const std::runtime_error&)
 					{
 						destroy();
-						throw std::runtime_error("gl::sl::Shader : fichier introuvable (" + input + ")");
+						throw;
 					}
-
-					// Lecture du contenu
-					while (getline(fichierSource, ligneCodeSource))
-						ostrSource << ligneCodeSource << '\n';
-					codeSource=ostrSource.str();
 				}
 				else
 					codeSource.swap(input);
@@ -108,7 +109,11 @@ namespace gl
 				glGetShaderiv(myid, GL_COMPILE_STATUS, &erreurCompilation);
 
 				if (erreurCompilation != GL_TRUE)
+				{
+					// The exception owns and deletes the shader
+					setID(0);
 					throw CompileException(type, input, myid);
+				}
 			}
 			GLenum getType()
 			{
@@ -118,6 +123,11 @@ namespace gl
 			{
 				return glIsShader(id());
 			}
+			/// File the shader was loaded from, empty if set from a string
+			const std::string& path() const
+			{
+				return m_path;
+			}
 			void bind() const
 			{
 				// There's no bind for Shader, discard...
@@ -126,18 +136,30 @@ namespace gl
 			virtual void instantiate()
 			{
 				GLuint myid = id();
-				if (!glIsShader(myid))
+				if (myid == 0)
 					myid = glCreateShader(type);
 				setID(myid);
 			}
 			virtual void destroy()
 			{
-				GLuint myid = id();
-				if (glIsShader(myid))
-					glDeleteShader(myid);
-				setID(myid);
+				DeletionQueue::Release(DeletionQueue::Kind::Shader, id());
+				setID(0);
 			}
+		private:
+			std::string m_path;
+		};
+		/// Compile log of a shader
+		std::string shaderInfoLog(GLuint shader);
+		/// Link log of a program
+		std::string programInfoLog(GLuint program);
+		/// Source code of one stage
+		struct ShaderSource
+		{
+			TypeShader type;
+			std::string code;
 		};
+		class ShaderWatcher;
+		class ShaderVariants;
 		class Collection
 		{
 		public:
@@ -186,6 +208,35 @@ namespace gl
 		class Program : public Object
 		{
 		public:
+			/// Active resource of a linked program, see reflect()
+			struct Resource
+			{
+				enum class Kind
+				{
+					Uniform,
+					UniformBlock,
+					Attribute,
+					StorageBlock
+				};
+				Kind kind = Kind::Uniform;
+				/// Name, without the "[0]" of arrays
+				std::string name;
+				uint32_t hash = 0;
+				/// Index of the resource in its interface (block index for blocks)
+				GLuint index = 0;
+				/// Location of uniforms and attributes, -1 for uniforms in blocks
+				GLint location = -1;
+				/// Type of uniforms and attributes (GL_FLOAT_VEC3...)
+				GLenum type = GL_NONE;
+				/// Array size of uniforms and attributes, data size in bytes of blocks
+				GLint size = 0;
+				/// Block of uniforms in blocks, -1 otherwise
+				GLint blockIndex = -1;
+				/// Offset of uniforms in their block, -1 otherwise
+				GLint offset = -1;
+				/// Binding point of blocks
+				GLint binding = -1;
+			};
 			class LinkException : public std::exception
 			{
 			public:
@@ -256,16 +307,129 @@ namespace gl
 			}
 			template <TypeShader type>
 			void attachShader(Shader<type>& shader)
+			{
+				attachShader(shader.id());
+				// Files are kept for the ShaderWatcher, they replace the stages of the previous link
+				if (!shader.path().empty())
+					m_attachedFiles.push_back({type, shader.path(), shader.id()});
+			}
+			/// Attach a shader by its name
+			void attachShader(GLuint shader)
 			{
 				if (isRef)
 					throw std::runtime_error("Program reference not accessible for attachment");
 				if (!exists())
 					instantiate();
-				glAttachShader(id(), shader.id());
+				glAttachShader(id(), shader);
 			}
+			/// Detach a shader, its file isn't watched anymore
+			void detachShader(GLuint shader);
+			/// Link the program. The uniform locations cached before are forgotten.
 			void link();
+			/**
+			 * @brief Start linking without waiting for the result
+			 *
+			 * With KHR_parallel_shader_compile, the driver links on its own threads : poll linkCompleted, then call checkLink.
+			 */
+			void submitLink();
+			/**
+			 * @brief True once the link started by submitLink is done, without blocking
+			 *
+			 * Always true without KHR_parallel_shader_compile.
+			 * @see [GL_KHR_parallel_shader_compile](https://registry.khronos.org/OpenGL/extensions/KHR/KHR_parallel_shader_compile.txt)
+			 */
+			bool linkCompleted() const;
+			/// End a link started by submitLink, waiting for it if needed. Throws LinkException like link.
+			void checkLink();
+			/**
+			 * @brief Ask the driver to keep the binary of the next link, for binary()
+			 * @see [glProgramParameter](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glProgramParameter.xhtml)
+			 */
+			void setBinaryRetrievable(bool enabled);
+			/**
+			 * @brief Allow the next link to make a program usable by a ProgramPipeline, with only some stages
+			 * @see [glProgramParameter](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glProgramParameter.xhtml)
+			 */
+			void setSeparable(bool enabled);
+			/**
+			 * @brief Binary of the linked program
+			 *
+			 * @param format Format of the binary, to give back to loadBinary
+			 * @see [glGetProgramBinary](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glGetProgramBinary.xhtml)
+			 */
+			std::vector<char> binary(GLenum& format) const;
+			/**
+			 * @brief Replace the program by a binary got from binary()
+			 *
+			 * Like link, the uniform locations cached before are forgotten.
+			 * @return false if the driver rejects the binary (other driver or version) : the program must be built from sources.
+			 * @see [glProgramBinary](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glProgramBinary.xhtml)
+			 */
+			bool loadBinary(GLenum format, const void* binary, GLsizei length);
 			GLint getUniformLocation(const std::string& name) const;
 			GLint getUniformLocation(const char* name) const;
+			/**
+			 * @brief Location of a uniform, from the cache of the program
+			 *
+			 * The driver is only queried the first time a name is asked. The cache is shared with the references to this program.
+			 * @see [glGetUniformLocation](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glGetUniformLocation.xhtml)
+			 */
+			GLint getUniformLocation(UniformName name) const;
+			/// Resolve a uniform once, to set it without lookup. With reflection, throws if the type of the uniform doesn't match.
+			template <typename Type>
+			UniformHandle<Type> uniformHandle(UniformName name) const
+			{
+				checkUniformType(name, detail::UniformType<Type>::value);
+				return UniformHandle<Type>(id(), getUniformLocation(name), m_state->shadow);
+			}
+			/// Set a uniform, skipped if the program already has this value (see uniformShadow).
+			template <typename Type>
+			void setUniform(GLint location, const Type& value) const
+			{
+				if (m_state->shadow->update(location, &value, sizeof(Type)))
+					detail::upload(id(), location, value);
+			}
+			/// Last values uploaded to the uniforms, with hit/miss counters. Shared with references and handles.
+			UniformShadow& uniformShadow() const
+			{
+				return *m_state->shadow;
+			}
+			/**
+			 * @brief Reflection at link
+			 *
+			 * When enabled, link() calls reflect(). Uniform locations then come from the table without driver call.
+			 */
+			void setReflection(bool enabled)
+			{
+				m_reflection = enabled;
+			}
+			bool reflection() const
+			{
+				return m_reflection;
+			}
+			/**
+			 * @brief Enumerate the active resources of the linked program
+			 *
+			 * Fill a table, sorted by kind and name hash, with the uniforms, uniform blocks, attributes and shader storage blocks.
+			 * Uses the program interface query (OpenGL 4.3) when available, glGetActiveUniform and co otherwise (no storage block then).
+			 * @see [glGetProgramInterfaceiv](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glGetProgramInterface.xhtml), [glGetActiveUniform](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glGetActiveUniform.xhtml)
+			 */
+			void reflect();
+			/// True if the table of resources is filled
+			bool reflected() const;
+			const std::vector<Resource>& resources() const;
+			/// Find a resource in the table, nullptr if not found or not reflected
+			const Resource* resource(Resource::Kind kind, UniformName name) const;
+			/**
+			 * @brief Set the binding point of a uniform block
+			 * @see [glUniformBlockBinding](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glUniformBlockBinding.xhtml)
+			 */
+			void bindUniformBlock(UniformName block, GLuint binding);
+			/**
+			 * @brief Set the binding point of a shader storage block (OpenGL 4.3)
+			 * @see [glShaderStorageBlockBinding](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glShaderStorageBlockBinding.xhtml)
+			 */
+			void bindStorageBlock(UniformName block, GLuint binding);
 
 			GLint getAttribLocation(const std::string& name) const;
 			GLint getAttribLocation(const char* name) const;
@@ -282,7 +446,108 @@ namespace gl
 			void instantiate();
 			void destroy();
 		private:
+			/// State of a program shared with its references
+			struct State
+			{
+				/// Uniform locations by name hash. The name is kept to detect collisions.
+				std::unordered_map<uint32_t, std::pair<std::string, GLint>> locations;
+				/// Resources sorted by kind then hash
+				std::vector<Resource> resources;
+				bool reflected = false;
+				UniformShadow::sptr shadow = std::make_shared<UniformShadow>();
+				/// Name replaced by a reload while references used it, deleted with the last of them
+				GLuint retired = 0;
+				State() = default;
+				State(const State&) = delete;
+				State& operator=(const State&) = delete;
+				~State();
+			};
+			friend class ShaderWatcher;
+			friend class ShaderVariants;
+			/// Forget the state of the previous link
+			void linked();
+			/// Take the name of a new linked program, used by ShaderWatcher
+			void replace(GLuint program);
+			/// Throw if the reflected type of a uniform isn't *expected*
+			void checkUniformType(UniformName name, GLenum expected) const;
+
 			bool isRef=false;
+			bool m_reflection = false;
+			std::shared_ptr<State> m_state = std::make_shared<State>();
+			/// Stage loaded from a file
+			struct StageFile
+			{
+				TypeShader type;
+				std::string path;
+				GLuint shader;
+			};
+			/// Stages of the last link loaded from files
+			std::vector<StageFile> m_files;
+			/// Stages attached from files since the last link
+			std::vector<StageFile> m_attachedFiles;
+			/// Watcher reloading this program, see ShaderWatcher
+			ShaderWatcher* m_watcher = nullptr;
+		};
+		/// Pipeline stage bit of a shader type (GL_VERTEX_SHADER_BIT...)
+		GLbitfield stageBit(TypeShader type);
+		/**
+		 * @brief Program pipeline, mixing the stages of separable programs
+		 *
+		 * Each stage comes from a program linked with setSeparable(true) : a vertex program can be shared by many fragment programs
+		 * without linking every pair. useStages only calls the driver for the stages whose program changes.
+		 * Uniforms of the programs are set with glProgramUniform* (OpenGL 4.1), without binding them.
+		 * ```cpp
+		 * vert.setSeparable(true);
+		 * vert << gl::sl::Shader<gl::sl::Vertex>("mesh.vert") << gl::sl::link;
+		 * pipeline.useStages(vert, GL_VERTEX_SHADER_BIT);
+		 * pipeline.useStages(frag, GL_FRAGMENT_SHADER_BIT);
+		 * pipeline.bind();
+		 * ```
+		 * @see [glUseProgramStages](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glUseProgramStages.xhtml)
+		 */
+		class ProgramPipeline : public Object
+		{
+		public:
+			DECL_PTR(ProgramPipeline)
+			ProgramPipeline();
+			~ProgramPipeline();
+			/**
+			 * @brief Use the stages of a separable program
+			 * @param stages Stage bits (GL_VERTEX_SHADER_BIT...), the stages missing in the program are cleared
+			 * @see [glUseProgramStages](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glUseProgramStages.xhtml)
+			 */
+			void useStages(const Program& program, GLbitfield stages = GL_ALL_SHADER_BITS);
+			/// Remove the programs of the stages
+			void clearStages(GLbitfield stages = GL_ALL_SHADER_BITS);
+			/// Program last given for a stage, 0 if none
+			GLuint stageProgram(TypeShader type) const;
+			/**
+			 * @brief Program receiving the glUniform* calls while the pipeline is bound
+			 * @see [glActiveShaderProgram](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glActiveShaderProgram.xhtml)
+			 */
+			void setActiveProgram(const Program& program);
+			/**
+			 * @brief Check that the stages can run together with the current state
+			 * @param log Filled with the info log of the pipeline
+			 * @see [glValidateProgramPipeline](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glValidateProgramPipeline.xhtml)
+			 */
+			bool validate(std::string* log = nullptr) const;
+			/// Bind the pipeline, and stop using a program so the pipeline takes effect
+			void bind() const;
+			/// @copydoc Object::instantiate
+			/// @see [glGenProgramPipelines](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glGenProgramPipelines.xhtml)
+			virtual void instantiate();
+		protected:
+			/// @copydoc Object::destroy
+			/// @see [glDeleteProgramPipelines](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glDeleteProgramPipelines.xhtml)
+			virtual void destroy();
+		private:
+			/// Vertex, tessellation control, tessellation evaluation, geometry, fragment, compute
+			constexpr static int Stages = 6;
+			static const std::array<GLbitfield, Stages> StageBits;
+
+			/// Program of each stage, to skip redundant glUseProgramStages
+			std::array<GLuint, Stages> m_stages{};
 		};
 		inline gl::sl::Program& link(gl::sl::Program& prog)
 		{
@@ -296,6 +561,11 @@ namespace gl
 		}
 
 	}
+	template <typename MyStruct>
+	void UniformBuffer<MyStruct>::bind(gl::sl::Program& program)
+	{
+		program.bindUniformBlock(m_blockName, m_bindPoint);
+	}
 }
 #define TRY_GLSL try {
 #define CATCH_GLSL }\
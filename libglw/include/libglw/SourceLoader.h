@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "config.h"
+
+namespace gl
+{
+	namespace sl
+	{
+		/**
+		 * @brief Shader files loader with #include resolution
+		 *
+		 * Each file is read with a single read call, and kept in memory with its modification time. `#include "file"`
+		 * directives are resolved relatively to the including file, then to the include paths. A file is included once
+		 * per shader, like with include guards, and `#pragma once` lines are dropped.
+		 *
+		 * Preprocessed sources are cached by path : loading it again only checks the modification time of the files
+		 * it depends on. Common headers are then read once per process, and edited files are read again.
+		 *
+		 * `#line` directives are inserted around each include : the source string number of a compile error
+		 * is the index of the file in files().
+		 *
+		 * Shader::set loads its files with Global().
+		 */
+		class SourceLoader
+		{
+		public:
+			struct Stats
+			{
+				/// Files read from the disk
+				uint64_t reads = 0;
+				/// Loads served from the cache
+				uint64_t hits = 0;
+			};
+			SourceLoader() = default;
+			SourceLoader(const SourceLoader&) = delete;
+			SourceLoader& operator=(const SourceLoader&) = delete;
+
+			/// Loader used by Shader
+			static SourceLoader& Global();
+			/// Modification time of a file, false if it doesn't exist
+			static bool ModificationTime(const std::string& path, int64_t& time);
+			/// Path with '/' separators and without "." and ".." parts, as kept by the loader
+			static std::string Normalize(const std::string& path);
+
+			/**
+			 * @brief Preprocessed source of a file
+			 *
+			 * Throws if the file or one of its includes can't be found.
+			 * The reference is valid until the next load of the same file.
+			 */
+			const std::string& load(const std::string& path);
+			/// Files of a loaded source, by source string number. The first one is the loaded file.
+			const std::vector<std::string>& files(const std::string& path) const;
+			/// Directory searched for includes not found next to the including file
+			void addIncludePath(std::string directory);
+			/// Forget every cached file
+			void clear();
+
+			const Stats& stats() const
+			{
+				return m_stats;
+			}
+			void resetStats()
+			{
+				m_stats = Stats();
+			}
+		private:
+			struct File
+			{
+				bool read = false;
+				int64_t time = 0;
+				std::string content;
+			};
+			struct Source
+			{
+				std::string code;
+				/// Included files, by source string number
+				std::vector<std::string> files;
+				/// Modification time of each file when loaded
+				std::vector<int64_t> times;
+			};
+			/// Content of a file, read again if modified
+			const File& file(const std::string& path);
+			/// Append the content of *index*-th file of *source*, with its includes
+			void expand(Source& source, size_t index);
+			/// Path of an included file, throws if not found
+			std::string resolve(const std::string& name, const std::string& includer) const;
+			bool upToDate(const Source& source) const;
+
+			std::unordered_map<std::string, File> m_files;
+			std::unordered_map<std::string, Source> m_sources;
+			std::vector<std::string> m_includePaths;
+			Stats m_stats;
+		};
+	}
+}
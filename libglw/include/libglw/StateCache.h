@@ -0,0 +1,147 @@
+#pragma once
+#include <GL/glew.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "config.h"
+
+namespace gl
+{
+	/**
+	 * @brief Shadow of the OpenGL binding state
+	 *
+	 * Every bind() of libglw goes through the cache of the current context, which skips the calls binding
+	 * an object already bound. It tracks the VAO, the buffer per target, the program and program pipeline, the active texture unit,
+	 * the texture per unit and target, the sampler per unit, the framebuffer per target and the renderbuffer.
+	 * It also tracks the row alignment and length of the pixel store (GL_(UN)PACK_ALIGNMENT, GL_(UN)PACK_ROW_LENGTH).
+	 *
+	 * A new cache matches the initial state of a context (everything bound to 0, texture unit 0).
+	 * If foreign code changes the bindings, call invalidate() : the next bind of each kind is then always issued.
+	 * The same goes for the pixel store : set it with pixelStore rather than glPixelStorei.
+	 *
+	 * There is one cache per thread, like the current context. When switching context on a thread, switch the cache with MakeCurrent.
+	 *
+	 * The cache never queries the driver. Built with LIBGLW_WITH_STATE_CHECK, every bind asserts check() to catch
+	 * bindings changed behind its back.
+	 */
+	class StateCache
+	{
+	public:
+		/// Bind counters
+		struct Stats
+		{
+			/// Binds sent to OpenGL
+			uint64_t issued = 0;
+			/// Binds skipped because already bound
+			uint64_t skipped = 0;
+		};
+		/// Value of a binding the cache doesn't know
+		constexpr static GLuint Unknown = ~0u;
+
+		StateCache();
+		/// Cache of the current thread.
+		static StateCache& Current();
+		/**
+		 * @brief Set the cache of the current thread
+		 *
+		 * Use one cache per context, and make it current with the context.
+		 * @param cache new cache, or nullptr to get back the default cache of the thread
+		 */
+		static void MakeCurrent(StateCache* cache);
+
+		/// Forget everything, to call after foreign code changed the bindings.
+		void invalidate();
+		/**
+		 * @brief Compare the known bindings with the driver
+		 *
+		 * Slow (one glGet per binding), for debugging. Textures and sampler are checked on the active unit only.
+		 * @return false if a binding doesn't match
+		 */
+		bool check() const;
+
+		/// @see [glBindBuffer](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glBindBuffer.xhtml)
+		void bindBuffer(GLenum target, GLuint id);
+		/// Record a buffer bound by other means (e.g. glBindBufferBase also binds the generic target).
+		void bufferBound(GLenum target, GLuint id);
+		/// @see [glBindVertexArray](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glBindVertexArray.xhtml)
+		void bindVertexArray(GLuint id);
+		/// @see [glUseProgram](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glUseProgram.xhtml)
+		void useProgram(GLuint id);
+		/// The pipeline is only used while no program is, see useProgram(0).
+		/// @see [glBindProgramPipeline](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glBindProgramPipeline.xhtml)
+		void bindProgramPipeline(GLuint id);
+		/// @param unit Texture unit index (not GL_TEXTUREi)
+		/// @see [glActiveTexture](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glActiveTexture.xhtml)
+		void activeTexture(GLuint unit);
+		/// Bind a texture on a unit, activating the unit only when the bind is needed.
+		/// @see [glBindTexture](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glBindTexture.xhtml)
+		void bindTexture(GLuint unit, GLenum target, GLuint id);
+		/// Bind a texture on the active unit.
+		void bindTexture(GLenum target, GLuint id);
+		/// @see [glBindSampler](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glBindSampler.xhtml)
+		void bindSampler(GLuint unit, GLuint id);
+		/// GL_FRAMEBUFFER binds both read and draw framebuffers.
+		/// @see [glBindFramebuffer](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glBindFramebuffer.xhtml)
+		void bindFramebuffer(GLenum target, GLuint id);
+		/// @see [glBindRenderbuffer](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glBindRenderbuffer.xhtml)
+		void bindRenderbuffer(GLuint id);
+		/// Only alignments and row lengths are cached, the other parameters are always set.
+		/// @see [glPixelStore](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glPixelStore.xhtml)
+		void pixelStore(GLenum parameter, GLint value);
+
+		/// @name Deletion notifications
+		/// Deleting a bound object unbinds it : objects call those when they delete their name.
+		/// @{
+		void deletedBuffer(GLuint id);
+		void deletedVertexArray(GLuint id);
+		void deletedTexture(GLuint id);
+		void deletedSampler(GLuint id);
+		void deletedFramebuffer(GLuint id);
+		void deletedRenderbuffer(GLuint id);
+		void deletedProgramPipeline(GLuint id);
+		/// @}
+
+		/// Active texture unit index, or Unknown
+		GLuint activeUnit() const
+		{
+			return m_activeUnit;
+		}
+		const Stats& stats() const
+		{
+			return m_stats;
+		}
+		void resetStats()
+		{
+			m_stats = Stats();
+		}
+	private:
+		constexpr static std::size_t BufferTargets = 14;
+		constexpr static std::size_t TextureTargets = 11;
+		constexpr static std::size_t PixelStoreParameters = 4;
+		using TextureUnit = std::array<GLuint, TextureTargets>;
+		/// Index of a target in the caches, or -1 if not cached
+		static int bufferSlot(GLenum target);
+		static int textureSlot(GLenum target);
+		static int pixelStoreSlot(GLenum parameter);
+		TextureUnit& unit(GLuint index);
+		/// Set *cached* to *id* and return true if a call is needed
+		bool update(GLuint& cached, GLuint id);
+
+		std::array<GLuint, BufferTargets> m_buffers;
+		GLuint m_vertexArray;
+		GLuint m_program;
+		GLuint m_pipeline;
+		GLuint m_activeUnit;
+		std::vector<TextureUnit> m_textures;
+		std::vector<GLuint> m_samplers;
+		GLuint m_readFramebuffer;
+		GLuint m_drawFramebuffer;
+		GLuint m_renderbuffer;
+		/// Values of the pixel store, in pixelStoreSlot order
+		std::array<GLuint, PixelStoreParameters> m_pixelStore;
+		/// Value of the bindings not stored yet (0 at creation, Unknown after invalidate)
+		GLuint m_default;
+		Stats m_stats;
+	};
+}
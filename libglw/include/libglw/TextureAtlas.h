@@ -0,0 +1,139 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "GLClass.h"
+
+namespace gl
+{
+	/**
+	 * @brief Many small images packed in one texture
+	 *
+	 * Regions are placed with the MaxRects algorithm (best short side fit) : each insert takes the free rectangle
+	 * wasting the least space, and removed regions give their space back for the next inserts.
+	 * Their pixels are uploaded with glTexSubImage2D, the images sharing the atlas are drawn with a single bind.
+	 *
+	 * Each region is surrounded by *padding* pixels repeating its border, so that linear filtering doesn't blend the neighbours.
+	 * With mipmaps, regions are aligned on 2^(levels-1) pixels : a texel of the smallest level never covers two regions,
+	 * and the space left by the alignment repeats the border too.
+	 * ```cpp
+	 * gl::TextureAtlas atlas(glm::ivec2(2048), GL_RGBA8);
+	 * auto icon = atlas.insert(glm::ivec2(32), GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	 * if (icon != gl::TextureAtlas::Invalid)
+	 *     quad.uv = atlas.uv(icon); // u0, v0, u1, v1
+	 * ```
+	 */
+	class TextureAtlas
+	{
+	public:
+		DECL_PTR(TextureAtlas)
+		using Handle = uint32_t;
+		constexpr static Handle Invalid = ~Handle(0);
+		/// Region of an image in the atlas
+		struct Entry
+		{
+			/// Position of the image, without padding, in pixels
+			glm::ivec2 position;
+			glm::ivec2 size;
+			/// Texture coordinates of the image : u0, v0, u1, v1
+			glm::vec4 uv;
+		};
+		/**
+		 * @param size Size of the texture
+		 * @param internalFormat Sized format of the texture
+		 * @param padding Border around each region, filled with its edge pixels
+		 * @param levels Mipmap levels, see generateMipmap
+		 */
+		TextureAtlas(glm::ivec2 size, GLenum internalFormat = GL_RGBA8, GLint padding = 1, GLsizei levels = 1);
+
+		/**
+		 * @brief Place an image and upload its pixels
+		 *
+		 * @param pixels Tightly packed rows, nullptr to only reserve the region (see update)
+		 * @return Invalid if there isn't enough space left
+		 */
+		Handle insert(glm::ivec2 size, GLenum format, GLenum type, const void* pixels);
+		/// Reserve a region, filled later by update
+		Handle insert(glm::ivec2 size)
+		{
+			return insert(size, GL_NONE, GL_NONE, nullptr);
+		}
+		/// Upload the pixels of a region, its border repeated over the padding and up to the aligned cells
+		/// @see [glTexSubImage2D](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glTexSubImage2D.xhtml)
+		void update(Handle handle, GLenum format, GLenum type, const void* pixels);
+		/// Free the region of an image. Its pixels stay until another image takes the space.
+		void remove(Handle handle);
+		/// Free every region
+		void clear();
+
+		const Entry& entry(Handle handle) const;
+		glm::vec4 uv(Handle handle) const
+		{
+			return entry(handle).uv;
+		}
+		/// Number of images in the atlas
+		size_t size() const
+		{
+			return m_count;
+		}
+		/// Part of the texture used by the regions, padding included
+		float occupancy() const;
+		/// Compute the mipmap levels, after the regions have been uploaded
+		void generateMipmap()
+		{
+			m_texture.generateMipmap();
+		}
+		Texture& texture()
+		{
+			return m_texture;
+		}
+		const Texture& texture() const
+		{
+			return m_texture;
+		}
+		void bind(GLuint activeTexture) const
+		{
+			m_texture.bind(activeTexture);
+		}
+	private:
+		/// Rectangle in cells of the packer
+		struct Rect
+		{
+			int x, y, w, h;
+			bool contains(const Rect& other) const
+			{
+				return other.x >= x && other.y >= y && other.x + other.w <= x + w && other.y + other.h <= y + h;
+			}
+			bool intersects(const Rect& other) const
+			{
+				return other.x < x + w && x < other.x + other.w && other.y < y + h && y < other.y + other.h;
+			}
+		};
+		struct Slot
+		{
+			Entry entry;
+			Rect rect;
+			bool used = false;
+		};
+		/// Best short side fit, false if no free rectangle is big enough
+		bool place(int w, int h, Rect& result) const;
+		/// Remove a placed rectangle from the free ones
+		void split(const Rect& used);
+		/// Give a rectangle back, merging it with its neighbours
+		void release(const Rect& rect);
+		/// Drop the free rectangles contained in another one
+		void prune();
+		const Slot& slot(Handle handle) const;
+
+		Texture m_texture;
+		glm::ivec2 m_size;
+		GLint m_padding;
+		/// Pixels per cell : regions are aligned on the smallest mipmap level
+		int m_cell;
+		std::vector<Rect> m_free;
+		std::vector<Slot> m_slots;
+		std::vector<Handle> m_freeSlots;
+		size_t m_count = 0;
+		/// Cells used by the regions
+		int64_t m_usedCells = 0;
+	};
+}
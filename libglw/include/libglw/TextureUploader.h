@@ -0,0 +1,160 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "GLClass.h"
+
+namespace gl
+{
+	/**
+	 * @brief Texture uploads through a pool of pixel unpack buffers
+	 *
+	 * Texture::load gives a client pointer to the driver, which copies it on the GL thread before returning.
+	 * Here the pixels are written into a mapped staging buffer (GL_PIXEL_UNPACK_BUFFER), possibly by a worker thread,
+	 * then process() only records glTexSubImage2D from the buffer : the copy to the texture is done by the GPU.
+	 * A fence placed after the copy tells when the staging buffer can be used again.
+	 * ```cpp
+	 * gl::TextureUploader uploader;
+	 * // GL thread
+	 * auto ticket = uploader.stage(texture, GL_RGBA, GL_UNSIGNED_BYTE, size);
+	 * // any thread, rows are ticket->rowPitch() bytes apart
+	 * decodeImage(file, ticket->data());
+	 * ticket->submit();
+	 * // GL thread, each frame
+	 * uploader.process();
+	 * ```
+	 * The texture must be allocated (init_null) and stay alive until its upload is done.
+	 * Staging, process and the destructor must be called on the GL thread.
+	 */
+	class TextureUploader
+	{
+	public:
+		DECL_PTR(TextureUploader)
+		/// Pixels of an upload, shared by the uploader and the thread writing them
+		class Upload
+		{
+		public:
+			/// Mapped staging memory, size() bytes. Valid until submit.
+			unsigned char* data() const
+			{
+				return m_data;
+			}
+			GLsizeiptr size() const
+			{
+				return m_size;
+			}
+			/// Bytes between two rows (rows are 4 bytes aligned, like GL_UNPACK_ALIGNMENT)
+			GLsizeiptr rowPitch() const
+			{
+				return m_rowPitch;
+			}
+			/// The pixels are written : the next process() records the copy. Can be called from any thread.
+			void submit()
+			{
+				m_submitted.store(true, std::memory_order_release);
+			}
+			/// True once the GPU has copied the pixels into the texture
+			bool done() const
+			{
+				return m_done.load(std::memory_order_acquire);
+			}
+		private:
+			friend class TextureUploader;
+			unsigned char* m_data = nullptr;
+			GLsizeiptr m_size = 0;
+			GLsizeiptr m_rowPitch = 0;
+			Texture* m_texture = nullptr;
+			GLenum m_format = GL_NONE;
+			GLenum m_type = GL_NONE;
+			glm::ivec2 m_offset;
+			glm::ivec2 m_extent;
+			GLint m_level = 0;
+			std::atomic<bool> m_submitted{false};
+			std::atomic<bool> m_done{false};
+		};
+		using Ticket = std::shared_ptr<Upload>;
+		struct Stats
+		{
+			/// Copies recorded from a staging buffer
+			uint64_t uploads = 0;
+			/// Bytes copied
+			uint64_t bytes = 0;
+			/// stage() calls which found no free staging buffer
+			uint64_t busy = 0;
+		};
+		/**
+		 * @param buffer_size Size in bytes of the staging buffers. A bigger upload gets a buffer of its size.
+		 * @param max_buffers Staging buffers in the pool
+		 */
+		explicit TextureUploader(GLsizeiptr buffer_size = 4 << 20, size_t max_buffers = 8);
+		TextureUploader(const TextureUploader&) = delete;
+		TextureUploader& operator=(const TextureUploader&) = delete;
+		/// Wait for the copies in progress. Uploads staged but not submitted are dropped.
+		~TextureUploader();
+
+		/**
+		 * @brief Map a staging buffer for the pixels of a texture region
+		 *
+		 * @param size Size of the region in pixels
+		 * @param offset Position of the region in the texture
+		 * @return nullptr if every staging buffer is in use : try again after the next process()
+		 */
+		Ticket stage(Texture& texture, GLenum format, GLenum type, glm::ivec2 size, glm::ivec2 offset = glm::ivec2(0), GLint level = 0);
+		/**
+		 * @brief Stage, copy tightly packed *pixels* and submit
+		 *
+		 * @return nullptr if every staging buffer is in use
+		 */
+		Ticket upload(Texture& texture, GLenum format, GLenum type, const void* pixels, glm::ivec2 size, glm::ivec2 offset = glm::ivec2(0), GLint level = 0);
+		/**
+		 * @brief Record the copies of the submitted uploads and recycle the staging buffers the GPU is done with
+		 *
+		 * Never waits for the GPU. Call it once per frame.
+		 * @return how many copies have been recorded
+		 * @see [glTexSubImage2D](https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glTexSubImage.xhtml)
+		 */
+		size_t process();
+		/// Wait until every submitted upload is done
+		void finish();
+		/// Uploads staged and not done yet
+		size_t pending() const;
+
+		const Stats& stats() const
+		{
+			return m_stats;
+		}
+		void resetStats()
+		{
+			m_stats = Stats();
+		}
+	private:
+		struct Staging
+		{
+			enum class State
+			{
+				Free,
+				/// Mapped, waiting for the pixels
+				Mapped,
+				/// Copy recorded, waiting for the fence
+				Copying
+			};
+			PixelUnpackBuffer buffer;
+			PixelUnpackBuffer::Mapping mapping;
+			Fence fence;
+			Ticket upload;
+			State state = State::Free;
+		};
+		/// Free staging buffer of at least *size* bytes, nullptr if none
+		Staging* acquire(GLsizeiptr size);
+		/// Recycle the buffers whose copy is done, true if some copies are still running
+		bool retire(bool wait);
+		/// Record the copy of a submitted upload
+		void copy(Staging& staging);
+
+		GLsizeiptr m_bufferSize;
+		size_t m_maxBuffers;
+		/// Buffers are referenced by their mappings : they don't move
+		std::vector<std::unique_ptr<Staging>> m_staging;
+		Stats m_stats;
+	};
+}
@@ -2,3 +2,5 @@
 #if LIBGLW_WITH_STD_FILESYSTEM
 #   include <filesystem>
 #endif
+#  define LIBGLW_WITH_DSA 0
+#  define LIBGLW_WITH_STATE_CHECK 0
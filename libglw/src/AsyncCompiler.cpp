@@ -0,0 +1,115 @@
+#include <libglw/AsyncCompiler.h>
+namespace gl
+{
+	namespace sl
+	{
+		namespace
+		{
+			const char* typeName(TypeShader type)
+			{
+				switch (type)
+				{
+				case gl::sl::Vertex: return "Vertex Shader";
+				case gl::sl::Fragment: return "Fragment Shader";
+				case gl::sl::Geometry: return "Geometry Shader";
+				case gl::sl::Compute: return "Compute Shader";
+				default: return "Shader";
+				}
+			}
+		}
+		AsyncCompiler::~AsyncCompiler()
+		{
+			for (auto& job : m_jobs)
+				for (auto& shader : job.shaders)
+					DeletionQueue::Release(DeletionQueue::Kind::Shader, shader.second);
+		}
+		bool AsyncCompiler::Parallel()
+		{
+			return GLEW_KHR_parallel_shader_compile;
+		}
+		void AsyncCompiler::SetMaxThreads(GLuint count)
+		{
+			if (Parallel())
+				glMaxShaderCompilerThreadsKHR(count);
+		}
+		AsyncCompiler::Ticket AsyncCompiler::submit(Program& program, const std::vector<ShaderSource>& sources, const std::string& name)
+		{
+			std::vector<std::pair<TypeShader, GLuint>> shaders;
+			shaders.reserve(sources.size());
+			for (const auto& source : sources)
+			{
+				GLuint shader = glCreateShader(source.type);
+				if (shader == 0)
+				{
+					for (auto& submitted : shaders)
+						DeletionQueue::Release(DeletionQueue::Kind::Shader, submitted.second);
+					throw std::runtime_error("gl::sl::AsyncCompiler::submit unknown shader type");
+				}
+				const GLchar* code = source.code.c_str();
+				glShaderSource(shader, 1, &code, nullptr);
+				glCompileShader(shader);
+				shaders.emplace_back(source.type, shader);
+				program.attachShader(shader);
+			}
+			// The link is queued after the compiles, no status is asked before poll
+			program.submitLink();
+			m_jobs.push_back({program, std::move(shaders), name, std::make_shared<Status>()});
+			return m_jobs.back().status;
+		}
+		size_t AsyncCompiler::poll()
+		{
+			size_t count = 0;
+			for (auto it = m_jobs.begin(); it != m_jobs.end();)
+			{
+				if (!it->program.linkCompleted())
+				{
+					++it;
+					continue;
+				}
+				end(*it);
+				it = m_jobs.erase(it);
+				++count;
+			}
+			return count;
+		}
+		void AsyncCompiler::finish()
+		{
+			for (auto& job : m_jobs)
+				end(job);
+			m_jobs.clear();
+		}
+		void AsyncCompiler::end(Job& job)
+		{
+			const GLuint program = job.program.id();
+			GLint link(0);
+			glGetProgramiv(program, GL_LINK_STATUS, &link);
+			if (link == GL_TRUE)
+			{
+				job.program.checkLink();
+				job.status->state = State::Ready;
+			}
+			else
+			{
+				// Report the stages which didn't compile, the link log otherwise
+				std::string error;
+				for (auto& shader : job.shaders)
+				{
+					GLint compiled(0);
+					glGetShaderiv(shader.second, GL_COMPILE_STATUS, &compiled);
+					if (compiled != GL_TRUE)
+						error += std::string("\nErreur de compilation du shader\nNom du Shader : ") + job.name + "\nType de shader : " + typeName(shader.first) + "\nErreur :\n" + shaderInfoLog(shader.second);
+				}
+				if (error.empty())
+					error = "\nErreur lors du link du program " + job.name + "\nErreur :\n" + programInfoLog(program);
+				job.status->error = std::move(error);
+				job.status->state = State::Failed;
+			}
+			for (auto& shader : job.shaders)
+			{
+				glDetachShader(program, shader.second);
+				DeletionQueue::Release(DeletionQueue::Kind::Shader, shader.second);
+			}
+			job.shaders.clear();
+		}
+	}
+}
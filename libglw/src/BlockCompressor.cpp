@@ -0,0 +1,400 @@
+#include <libglw/BlockCompressor.h>
+#include <algorithm>
+#include <cstring>
+#if defined(__AVX2__)
+#	include <immintrin.h>
+#	define LIBGLW_BC_AVX2 1
+#	define LIBGLW_BC_SSE2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define LIBGLW_BC_SSE2 1
+#endif
+namespace gl
+{
+	namespace
+	{
+		/// 4x4 RGBA pixels of a block, row by row
+		struct alignas(32) Block
+		{
+			uint8_t rgba[64];
+		};
+
+		void gather(const unsigned char* pixels, glm::ivec2 size, int channels, int bx, int by, Block& block)
+		{
+			const int x0 = bx * 4, y0 = by * 4;
+			if (channels == 4 && x0 + 4 <= size.x && y0 + 4 <= size.y)
+			{
+				for (int y = 0; y < 4; ++y)
+					std::memcpy(block.rgba + y * 16, pixels + (static_cast<size_t>(y0 + y) * size.x + x0) * 4, 16);
+				return;
+			}
+			// Partial blocks repeat the last row and column
+			for (int y = 0; y < 4; ++y)
+			{
+				const int sy = std::min(y0 + y, size.y - 1);
+				for (int x = 0; x < 4; ++x)
+				{
+					const int sx = std::min(x0 + x, size.x - 1);
+					const unsigned char* p = pixels + (static_cast<size_t>(sy) * size.x + sx) * channels;
+					uint8_t* d = block.rgba + (y * 4 + x) * 4;
+					d[0] = p[0];
+					d[1] = channels > 1 ? p[1] : 0;
+					d[2] = channels > 2 ? p[2] : 0;
+					d[3] = channels > 3 ? p[3] : 255;
+				}
+			}
+		}
+		/// Bounding box of the colors of a block
+		void bounds(const Block& block, uint8_t low[4], uint8_t high[4])
+		{
+#if LIBGLW_BC_SSE2
+			const __m128i* rows = reinterpret_cast<const __m128i*>(block.rgba);
+			__m128i mn = _mm_min_epu8(_mm_min_epu8(_mm_load_si128(rows), _mm_load_si128(rows + 1)), _mm_min_epu8(_mm_load_si128(rows + 2), _mm_load_si128(rows + 3)));
+			__m128i mx = _mm_max_epu8(_mm_max_epu8(_mm_load_si128(rows), _mm_load_si128(rows + 1)), _mm_max_epu8(_mm_load_si128(rows + 2), _mm_load_si128(rows + 3)));
+			// Fold the four pixels of the rows
+			mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 8));
+			mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 4));
+			mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 8));
+			mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 4));
+			const int32_t lowBits = _mm_cvtsi128_si32(mn), highBits = _mm_cvtsi128_si32(mx);
+			std::memcpy(low, &lowBits, 4);
+			std::memcpy(high, &highBits, 4);
+#else
+			for (int c = 0; c < 4; ++c)
+			{
+				low[c] = 255;
+				high[c] = 0;
+			}
+			for (int i = 0; i < 16; ++i)
+				for (int c = 0; c < 4; ++c)
+				{
+					low[c] = std::min(low[c], block.rgba[i * 4 + c]);
+					high[c] = std::max(high[c], block.rgba[i * 4 + c]);
+				}
+#endif
+		}
+		/**
+		 * Position of each pixel on the segment origin -> origin + axis, rounded to 0..3
+		 * @param length2 squared length of the axis, not 0
+		 */
+		void colorLevels(const Block& block, const int origin[3], const int axis[3], int length2, uint8_t levels[16])
+		{
+#if LIBGLW_BC_AVX2
+			const __m256i zero = _mm256_setzero_si256();
+			const __m256i origin16 = _mm256_setr_epi16(
+				origin[0], origin[1], origin[2], 0, origin[0], origin[1], origin[2], 0,
+				origin[0], origin[1], origin[2], 0, origin[0], origin[1], origin[2], 0);
+			const __m256i axis16 = _mm256_setr_epi16(
+				axis[0], axis[1], axis[2], 0, axis[0], axis[1], axis[2], 0,
+				axis[0], axis[1], axis[2], 0, axis[0], axis[1], axis[2], 0);
+			const __m256 scale = _mm256_set1_ps(3.f / length2);
+			const __m256 half = _mm256_set1_ps(0.5f), last = _mm256_set1_ps(3.f), first = _mm256_setzero_ps();
+			// 8 pixels at once : the unpacks work per 128 bits lane, the shuffles put the pixels back in order
+			for (int i = 0; i < 2; ++i)
+			{
+				const __m256i pixels = _mm256_load_si256(reinterpret_cast<const __m256i*>(block.rgba) + i);
+				const __m256i lo = _mm256_madd_epi16(_mm256_sub_epi16(_mm256_unpacklo_epi8(pixels, zero), origin16), axis16);
+				const __m256i hi = _mm256_madd_epi16(_mm256_sub_epi16(_mm256_unpackhi_epi8(pixels, zero), origin16), axis16);
+				const __m256 rg = _mm256_shuffle_ps(_mm256_castsi256_ps(lo), _mm256_castsi256_ps(hi), _MM_SHUFFLE(2, 0, 2, 0));
+				const __m256 ba = _mm256_shuffle_ps(_mm256_castsi256_ps(lo), _mm256_castsi256_ps(hi), _MM_SHUFFLE(3, 1, 3, 1));
+				const __m256i dot = _mm256_add_epi32(_mm256_castps_si256(rg), _mm256_castps_si256(ba));
+				__m256 level = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(dot), scale), half);
+				level = _mm256_min_ps(_mm256_max_ps(level, first), last);
+				__m256i packed = _mm256_cvttps_epi32(level);
+				packed = _mm256_packus_epi16(_mm256_packs_epi32(packed, packed), zero);
+				const int32_t low = _mm_cvtsi128_si32(_mm256_castsi256_si128(packed));
+				const int32_t high = _mm_cvtsi128_si32(_mm256_extracti128_si256(packed, 1));
+				std::memcpy(levels + i * 8, &low, 4);
+				std::memcpy(levels + i * 8 + 4, &high, 4);
+			}
+#elif LIBGLW_BC_SSE2
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i origin16 = _mm_setr_epi16(origin[0], origin[1], origin[2], 0, origin[0], origin[1], origin[2], 0);
+			const __m128i axis16 = _mm_setr_epi16(axis[0], axis[1], axis[2], 0, axis[0], axis[1], axis[2], 0);
+			const __m128 scale = _mm_set1_ps(3.f / length2);
+			const __m128 half = _mm_set1_ps(0.5f), last = _mm_set1_ps(3.f), first = _mm_setzero_ps();
+			for (int i = 0; i < 4; ++i)
+			{
+				const __m128i pixels = _mm_load_si128(reinterpret_cast<const __m128i*>(block.rgba) + i);
+				// Products summed by pairs : (r, g) and (b, a) of each pixel
+				const __m128i lo = _mm_madd_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(pixels, zero), origin16), axis16);
+				const __m128i hi = _mm_madd_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(pixels, zero), origin16), axis16);
+				const __m128 rg = _mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(2, 0, 2, 0));
+				const __m128 ba = _mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(3, 1, 3, 1));
+				const __m128i dot = _mm_add_epi32(_mm_castps_si128(rg), _mm_castps_si128(ba));
+				__m128 level = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(dot), scale), half);
+				level = _mm_min_ps(_mm_max_ps(level, first), last);
+				__m128i packed = _mm_cvttps_epi32(level);
+				packed = _mm_packus_epi16(_mm_packs_epi32(packed, packed), zero);
+				const int32_t bytes = _mm_cvtsi128_si32(packed);
+				std::memcpy(levels + i * 4, &bytes, 4);
+			}
+#else
+			const float scale = 3.f / length2;
+			for (int i = 0; i < 16; ++i)
+			{
+				const uint8_t* p = block.rgba + i * 4;
+				const int dot = (p[0] - origin[0]) * axis[0] + (p[1] - origin[1]) * axis[1] + (p[2] - origin[2]) * axis[2];
+				const float level = std::min(std::max(dot * scale + 0.5f, 0.f), 3.f);
+				levels[i] = static_cast<uint8_t>(level);
+			}
+#endif
+		}
+		/// Position of each value between *low* and *low + range*, rounded to 0..7
+		void channelLevels(const uint8_t values[16], int low, int range, uint8_t levels[16])
+		{
+#if LIBGLW_BC_AVX2
+			const __m256 offset = _mm256_set1_ps(static_cast<float>(low)), scale = _mm256_set1_ps(7.f / range);
+			const __m256 half = _mm256_set1_ps(0.5f), last = _mm256_set1_ps(7.f), first = _mm256_setzero_ps();
+			for (int i = 0; i < 2; ++i)
+			{
+				const __m256i value = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(values + i * 8)));
+				__m256 level = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(value), offset), scale), half);
+				level = _mm256_min_ps(_mm256_max_ps(level, first), last);
+				__m256i packed = _mm256_cvttps_epi32(level);
+				packed = _mm256_packus_epi16(_mm256_packs_epi32(packed, packed), _mm256_setzero_si256());
+				const int32_t lowBytes = _mm_cvtsi128_si32(_mm256_castsi256_si128(packed));
+				const int32_t highBytes = _mm_cvtsi128_si32(_mm256_extracti128_si256(packed, 1));
+				std::memcpy(levels + i * 8, &lowBytes, 4);
+				std::memcpy(levels + i * 8 + 4, &highBytes, 4);
+			}
+#elif LIBGLW_BC_SSE2
+			const __m128i zero = _mm_setzero_si128();
+			const __m128 offset = _mm_set1_ps(static_cast<float>(low)), scale = _mm_set1_ps(7.f / range);
+			const __m128 half = _mm_set1_ps(0.5f), last = _mm_set1_ps(7.f), first = _mm_setzero_ps();
+			const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values));
+			const __m128i words[2] = { _mm_unpacklo_epi8(bytes, zero), _mm_unpackhi_epi8(bytes, zero) };
+			__m128i packed[4];
+			for (int i = 0; i < 4; ++i)
+			{
+				const __m128i value = (i & 1) ? _mm_unpackhi_epi16(words[i / 2], zero) : _mm_unpacklo_epi16(words[i / 2], zero);
+				__m128 level = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(value), offset), scale), half);
+				level = _mm_min_ps(_mm_max_ps(level, first), last);
+				packed[i] = _mm_cvttps_epi32(level);
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(levels), _mm_packus_epi16(_mm_packs_epi32(packed[0], packed[1]), _mm_packs_epi32(packed[2], packed[3])));
+#else
+			const float scale = 7.f / range;
+			for (int i = 0; i < 16; ++i)
+			{
+				const float level = std::min(std::max((values[i] - low) * scale + 0.5f, 0.f), 7.f);
+				levels[i] = static_cast<uint8_t>(level);
+			}
+#endif
+		}
+		uint16_t pack565(const uint8_t color[3])
+		{
+			return static_cast<uint16_t>(((color[0] * 31 + 127) / 255) << 11 | ((color[1] * 63 + 127) / 255) << 5 | ((color[2] * 31 + 127) / 255));
+		}
+		void unpack565(uint16_t packed, int color[3])
+		{
+			const int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+			color[0] = (r << 3) | (r >> 2);
+			color[1] = (g << 2) | (g >> 4);
+			color[2] = (b << 3) | (b >> 2);
+		}
+		void write(unsigned char* out, uint64_t value, int bytes)
+		{
+			for (int i = 0; i < bytes; ++i)
+				out[i] = static_cast<unsigned char>(value >> (8 * i));
+		}
+		/// BC1 block : two 565 endpoints and 2 bits per pixel
+		void encodeColor(const Block& block, unsigned char* out)
+		{
+			uint8_t low[4], high[4];
+			bounds(block, low, high);
+			// Inset the box : the extreme colors are rarely worth an endpoint
+			for (int c = 0; c < 3; ++c)
+			{
+				const int inset = (high[c] - low[c]) >> 4;
+				low[c] = static_cast<uint8_t>(low[c] + inset);
+				high[c] = static_cast<uint8_t>(high[c] - inset);
+			}
+			// high >= low per channel : color0 >= color1, the four colors mode
+			const uint16_t color0 = pack565(high), color1 = pack565(low);
+			uint32_t indices = 0;
+			if (color0 != color1)
+			{
+				int end[3], origin[3], axis[3];
+				unpack565(color0, end);
+				unpack565(color1, origin);
+				int length2 = 0;
+				for (int c = 0; c < 3; ++c)
+				{
+					axis[c] = end[c] - origin[c];
+					length2 += axis[c] * axis[c];
+				}
+				alignas(16) uint8_t levels[16];
+				colorLevels(block, origin, axis, length2, levels);
+				// Levels from color1 to color0, in the index order of BC1
+				static const uint32_t order[4] = { 1, 3, 2, 0 };
+				for (int i = 0; i < 16; ++i)
+					indices |= order[levels[i]] << (2 * i);
+			}
+			write(out, color0, 2);
+			write(out + 2, color1, 2);
+			write(out + 4, indices, 4);
+		}
+		/// BC4 block : two 8 bits endpoints and 3 bits per pixel
+		void encodeChannel(const Block& block, int channel, unsigned char* out)
+		{
+			alignas(16) uint8_t values[16];
+			uint8_t low = 255, high = 0;
+			for (int i = 0; i < 16; ++i)
+			{
+				values[i] = block.rgba[i * 4 + channel];
+				low = std::min(low, values[i]);
+				high = std::max(high, values[i]);
+			}
+			// high > low : the eight values mode
+			out[0] = high;
+			out[1] = low;
+			uint64_t indices = 0;
+			if (high > low)
+			{
+				alignas(16) uint8_t levels[16];
+				channelLevels(values, low, high - low, levels);
+				static const uint64_t order[8] = { 1, 7, 6, 5, 4, 3, 2, 0 };
+				for (int i = 0; i < 16; ++i)
+					indices |= order[levels[i]] << (3 * i);
+			}
+			write(out + 2, indices, 6);
+		}
+	}
+	BlockCompressor::BlockCompressor(unsigned threads)
+	{
+		if (threads == 0)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		for (unsigned i = 1; i < threads; ++i)
+			m_threads.emplace_back(&BlockCompressor::worker, this);
+	}
+	BlockCompressor::~BlockCompressor()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_wake.notify_all();
+		for (auto& thread : m_threads)
+			thread.join();
+	}
+	GLenum BlockCompressor::InternalFormat(Format format)
+	{
+		switch (format)
+		{
+		case BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		case BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		case BC4: return GL_COMPRESSED_RED_RGTC1;
+		case BC5: return GL_COMPRESSED_RG_RGTC2;
+		}
+		throw std::runtime_error("gl::BlockCompressor unknown format");
+	}
+	GLsizei BlockCompressor::BlockBytes(Format format)
+	{
+		return format == BC1 || format == BC4 ? 8 : 16;
+	}
+	GLsizei BlockCompressor::CompressedSize(Format format, glm::ivec2 size)
+	{
+		return ((size.x + 3) / 4) * ((size.y + 3) / 4) * BlockBytes(format);
+	}
+	const char* BlockCompressor::InstructionSet()
+	{
+#if LIBGLW_BC_AVX2
+		return "AVX2";
+#elif LIBGLW_BC_SSE2
+		return "SSE2";
+#else
+		return "C++";
+#endif
+	}
+	std::vector<unsigned char> BlockCompressor::compress(Format format, const unsigned char* pixels, glm::ivec2 size, int channels)
+	{
+		std::vector<unsigned char> output(CompressedSize(format, size));
+		compress(format, pixels, size, channels, output.data());
+		return output;
+	}
+	void BlockCompressor::compress(Format format, const unsigned char* pixels, glm::ivec2 size, int channels, unsigned char* output)
+	{
+		if (size.x <= 0 || size.y <= 0 || channels < 1 || channels > 4)
+			throw std::runtime_error("gl::BlockCompressor::compress invalid image");
+		const int blocksX = (size.x + 3) / 4, blocksY = (size.y + 3) / 4;
+		const GLsizei blockBytes = BlockBytes(format);
+		run(blocksY, [=](size_t row) {
+			Block block;
+			const int by = static_cast<int>(row);
+			unsigned char* out = output + static_cast<size_t>(by) * blocksX * blockBytes;
+			for (int bx = 0; bx < blocksX; ++bx, out += blockBytes)
+			{
+				gather(pixels, size, channels, bx, by, block);
+				switch (format)
+				{
+				case BC1:
+					encodeColor(block, out);
+					break;
+				case BC3:
+					encodeChannel(block, 3, out);
+					encodeColor(block, out + 8);
+					break;
+				case BC4:
+					encodeChannel(block, 0, out);
+					break;
+				case BC5:
+					encodeChannel(block, 0, out);
+					encodeChannel(block, 1, out + 8);
+					break;
+				}
+			}
+		});
+	}
+	void BlockCompressor::run(size_t rows, std::function<void(size_t)> job)
+	{
+		auto batch = std::make_shared<Batch>();
+		batch->job = std::move(job);
+		batch->rows = rows;
+		if (m_threads.empty() || rows < 2)
+		{
+			work(*batch);
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_batch = batch;
+			++m_generation;
+		}
+		m_wake.notify_all();
+		work(*batch);
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done.wait(lock, [&batch, rows] { return batch->finished.load() == rows; });
+		m_batch.reset();
+	}
+	void BlockCompressor::work(Batch& batch)
+	{
+		for (size_t row; (row = batch.next++) < batch.rows;)
+		{
+			batch.job(row);
+			if (++batch.finished == batch.rows)
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_done.notify_all();
+			}
+		}
+	}
+	void BlockCompressor::worker()
+	{
+		uint64_t seen = 0;
+		for (;;)
+		{
+			std::shared_ptr<Batch> batch;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wake.wait(lock, [this, seen] { return m_stop || m_generation != seen; });
+				if (m_stop)
+					return;
+				seen = m_generation;
+				batch = m_batch;
+			}
+			if (batch)
+				work(*batch);
+		}
+	}
+}
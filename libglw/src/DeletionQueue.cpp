@@ -0,0 +1,126 @@
+#include <libglw/DeletionQueue.h>
+#include <libglw/NamePool.h>
+namespace gl
+{
+	namespace
+	{
+		std::atomic<bool> g_deferred{false};
+
+		bool isSignaled(GLsync sync)
+		{
+			GLenum status = glClientWaitSync(sync, 0, 0);
+			return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+		}
+	}
+	DeletionQueue::~DeletionQueue()
+	{
+		auto freeNodes = [](Node* node) {
+			while (node)
+			{
+				Node* next = node->next;
+				delete node;
+				node = next;
+			}
+		};
+		freeNodes(take());
+		for (auto& batch : m_batches)
+			freeNodes(batch.nodes);
+	}
+	DeletionQueue& DeletionQueue::Global()
+	{
+		static DeletionQueue queue;
+		return queue;
+	}
+	void DeletionQueue::SetDeferred(bool enabled)
+	{
+		g_deferred.store(enabled, std::memory_order_relaxed);
+	}
+	bool DeletionQueue::GetDeferred()
+	{
+		return g_deferred.load(std::memory_order_relaxed);
+	}
+	void DeletionQueue::Release(Kind kind, GLuint name, GLenum target)
+	{
+		if (name == 0)
+			return;
+		if (GetDeferred())
+			Global().push(kind, name, target);
+		else
+			releaseNow(kind, name, target, false);
+	}
+	void DeletionQueue::push(Kind kind, GLuint name, GLenum target)
+	{
+		Node* node = new Node{kind, name, target, m_head.load(std::memory_order_relaxed)};
+		while (!m_head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed))
+			;
+	}
+	DeletionQueue::Node* DeletionQueue::take()
+	{
+		return m_head.exchange(nullptr, std::memory_order_acquire);
+	}
+	size_t DeletionQueue::process()
+	{
+		size_t count = 0;
+		Node* nodes = take();
+		if (!m_fenced)
+			count += release(nodes);
+		else if (nodes)
+			m_batches.push_back({glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), nodes});
+		// Batches are fenced in order : stop at the first one the GPU didn't pass
+		while (!m_batches.empty() && isSignaled(m_batches.front().sync))
+		{
+			glDeleteSync(m_batches.front().sync);
+			count += release(m_batches.front().nodes);
+			m_batches.pop_front();
+		}
+		NamePools::Current().flush();
+		return count;
+	}
+	size_t DeletionQueue::flush()
+	{
+		size_t count = 0;
+		for (auto& batch : m_batches)
+		{
+			glDeleteSync(batch.sync);
+			count += release(batch.nodes);
+		}
+		m_batches.clear();
+		count += release(take());
+		NamePools::Current().flush();
+		return count;
+	}
+	size_t DeletionQueue::release(Node* nodes)
+	{
+		size_t count = 0;
+		while (nodes)
+		{
+			Node* next = nodes->next;
+			releaseNow(nodes->kind, nodes->name, nodes->target, true);
+			delete nodes;
+			nodes = next;
+			++count;
+		}
+		return count;
+	}
+	void DeletionQueue::releaseNow(Kind kind, GLuint name, GLenum target, bool batched)
+	{
+		NamePools& pools = NamePools::Current();
+		NamePool* pool = nullptr;
+		switch (kind)
+		{
+		case Kind::Buffer: pool = &pools.buffers; break;
+		case Kind::VertexArray: pool = &pools.vertexArrays; break;
+		case Kind::Texture: pool = &pools.textures(target); break;
+		case Kind::Sampler: pool = &pools.samplers; break;
+		case Kind::Framebuffer: pool = &pools.framebuffers; break;
+		case Kind::Renderbuffer: pool = &pools.renderbuffers; break;
+		case Kind::ProgramPipeline: pool = &pools.programPipelines; break;
+		case Kind::Program: glDeleteProgram(name); return;
+		case Kind::Shader: glDeleteShader(name); return;
+		}
+		pool->release(name);
+		// Outside of process and flush, nothing deletes the batch later
+		if (!batched)
+			pool->flush();
+	}
+}
@@ -1,7 +1,41 @@
 #include <libglw/GLClass.h>
 #include <libglw/GLImpl_Helper>
+#include <cassert>
+#include <cstring>
 namespace gl
 {
+	namespace
+	{
+		/// Sized internal format needed by immutable storage, from an unsized one
+		GLenum sizedFormat(GLenum format)
+		{
+			switch (format)
+			{
+			case GL_RED: return GL_R8;
+			case GL_RG: return GL_RG8;
+			case GL_RGB: return GL_RGB8;
+			case GL_RGBA: return GL_RGBA8;
+			case GL_SRGB: return GL_SRGB8;
+			case GL_SRGB_ALPHA: return GL_SRGB8_ALPHA8;
+			case GL_DEPTH_COMPONENT: return GL_DEPTH_COMPONENT24;
+			case GL_DEPTH_STENCIL: return GL_DEPTH24_STENCIL8;
+			default: return format;
+			}
+		}
+		/// Number of levels of a full mipmap chain
+		GLsizei mipmapLevels(glm::ivec2 size)
+		{
+			GLsizei levels = 1;
+			for (int biggest = glm::max(size.x, size.y); biggest > 1; biggest >>= 1)
+				++levels;
+			return levels;
+		}
+		/// Targets allocated with glTexStorage3D
+		bool isLayered(GLenum target)
+		{
+			return target == GL_TEXTURE_3D || target == GL_TEXTURE_2D_ARRAY || target == GL_TEXTURE_CUBE_MAP_ARRAY;
+		}
+	}
 	bool Object::m_auto_inst=false;
 	Object::Object()
 	{
@@ -16,6 +50,12 @@ namespace gl
 		m_id = other.m_id;
 		other.m_id = 0;
 	}
+	Object& Object::operator=(Object&& other)
+	{
+		// The other object deletes our previous name
+		swap(other);
+		return *this;
+	}
 	Object::~Object()
 	{
 
@@ -30,6 +70,92 @@ namespace gl
 	{
 		m_id = id;
 	}
+	bool UniformShadow::update(GLint location, const void* value, size_t size)
+	{
+		// Setting an inactive uniform does nothing
+		if (location == -1)
+			return false;
+		if (size > MaxSize)
+		{
+			++m_stats.misses;
+			return true;
+		}
+		Value& shadow = m_values[location];
+		if (shadow.size == size && std::memcmp(shadow.bytes, value, size) == 0)
+		{
+			++m_stats.hits;
+			return false;
+		}
+		std::memcpy(shadow.bytes, value, size);
+		shadow.size = size;
+		++m_stats.misses;
+		return true;
+	}
+	void UniformShadow::clear()
+	{
+		m_values.clear();
+	}
+	Fence::Fence()
+	{
+	}
+	Fence::Fence(Fence&& other) : m_sync(other.m_sync)
+	{
+		other.m_sync = nullptr;
+	}
+	Fence& Fence::operator=(Fence&& other)
+	{
+		using std::swap;
+		swap(m_sync, other.m_sync);
+		return *this;
+	}
+	Fence::~Fence()
+	{
+		reset();
+	}
+	void Fence::place()
+	{
+		reset();
+		m_sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+	bool Fence::isSignaled()
+	{
+		if (!m_sync)
+			return true;
+		GLenum status = glClientWaitSync(m_sync, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		if (status == GL_TIMEOUT_EXPIRED)
+			return false;
+		if (status == GL_WAIT_FAILED)
+			throw std::runtime_error("gl::Fence::isSignaled failed");
+		reset();
+		return true;
+	}
+	bool Fence::wait(GLuint64 timeout)
+	{
+		if (!m_sync)
+			return true;
+		// Only flush on the first try, like recommended by the spec
+		GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+		GLuint64 step = timeout == GL_TIMEOUT_IGNORED ? 1000000 : timeout;
+		for (;;)
+		{
+			GLenum status = glClientWaitSync(m_sync, flags, step);
+			if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+				break;
+			if (status == GL_WAIT_FAILED)
+				throw std::runtime_error("gl::Fence::wait failed");
+			if (timeout != GL_TIMEOUT_IGNORED)
+				return false;
+			flags = 0;
+		}
+		reset();
+		return true;
+	}
+	void Fence::reset()
+	{
+		if (m_sync)
+			glDeleteSync(m_sync);
+		m_sync = nullptr;
+	}
 	Sampler::Sampler() : Object()
 	{
 		if (Object::GetAutoInstantiate())
@@ -39,25 +165,37 @@ namespace gl
 	{
 		destroy();
 	}
+	namespace
+	{
+		/// Index of the active texture unit, queried only when the cache doesn't know it
+		GLuint activeUnit()
+		{
+			GLuint unit = StateCache::Current().activeUnit();
+			if (unit == StateCache::Unknown)
+			{
+				int currentActive;
+				glGetIntegerv(GL_ACTIVE_TEXTURE, &currentActive);
+				unit = static_cast<GLuint>(currentActive - GL_TEXTURE0);
+				StateCache::Current().activeTexture(unit);
+			}
+			return unit;
+		}
+	}
 	void Sampler::bind() const
 	{
-		int currentActive;
-		glGetIntegerv(GL_ACTIVE_TEXTURE, &currentActive);
-		glBindSampler(currentActive, id());
+		StateCache::Current().bindSampler(activeUnit(), id());
 	}
 	void Sampler::bind(GLuint activeTexture) const
 	{
-		glBindSampler(activeTexture, id());
+		StateCache::Current().bindSampler(activeTexture, id());
 	}
 	void Sampler::unbind() const
 	{
-		int currentActive;
-		glGetIntegerv(GL_ACTIVE_TEXTURE, &currentActive);
-		glBindSampler(currentActive, 0);
+		StateCache::Current().bindSampler(activeUnit(), 0);
 	}
 	void Sampler::unbind(GLuint activeTexture) const
 	{
-		glBindSampler(activeTexture, 0);
+		StateCache::Current().bindSampler(activeTexture, 0);
 	}
 	void Sampler::setParameter(GLenum paramName, int value)
 	{
@@ -136,16 +274,67 @@ namespace gl
 	void Sampler::instantiate()
 	{
 		GLuint myID = id();
-		if (!glIsSampler(myID))
-			glGenSamplers(1, &myID);
+		if (myID == 0)
+			myID = NamePools::Current().samplers.acquire();
 		setID(myID);
 	}
 	void Sampler::destroy()
 	{
-		GLuint myID = id();
-		if (glIsSampler(myID))
-			glGenSamplers(1, &myID);
-		setID(myID);
+		DeletionQueue::Release(DeletionQueue::Kind::Sampler, id());
+		setID(0);
+	}
+	GLsizeiptr pixelSize(GLenum format, GLenum type)
+	{
+		// Packed types hold the whole pixel
+		switch (type)
+		{
+		case GL_UNSIGNED_BYTE_3_3_2: case GL_UNSIGNED_BYTE_2_3_3_REV:
+			return 1;
+		case GL_UNSIGNED_SHORT_5_6_5: case GL_UNSIGNED_SHORT_5_6_5_REV:
+		case GL_UNSIGNED_SHORT_4_4_4_4: case GL_UNSIGNED_SHORT_4_4_4_4_REV:
+		case GL_UNSIGNED_SHORT_5_5_5_1: case GL_UNSIGNED_SHORT_1_5_5_5_REV:
+			return 2;
+		case GL_UNSIGNED_INT_8_8_8_8: case GL_UNSIGNED_INT_8_8_8_8_REV:
+		case GL_UNSIGNED_INT_10_10_10_2: case GL_UNSIGNED_INT_2_10_10_10_REV:
+		case GL_UNSIGNED_INT_24_8: case GL_UNSIGNED_INT_10F_11F_11F_REV: case GL_UNSIGNED_INT_5_9_9_9_REV:
+			return 4;
+		case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+			return 8;
+		}
+		GLsizeiptr components;
+		switch (format)
+		{
+		case GL_RED: case GL_GREEN: case GL_BLUE: case GL_RED_INTEGER: case GL_STENCIL_INDEX: case GL_DEPTH_COMPONENT:
+			components = 1;
+			break;
+		case GL_RG: case GL_RG_INTEGER: case GL_DEPTH_STENCIL:
+			components = 2;
+			break;
+		case GL_RGB: case GL_BGR: case GL_RGB_INTEGER: case GL_BGR_INTEGER:
+			components = 3;
+			break;
+		case GL_RGBA: case GL_BGRA: case GL_RGBA_INTEGER: case GL_BGRA_INTEGER:
+			components = 4;
+			break;
+		default:
+			throw std::runtime_error("gl::pixelSize unknown format");
+		}
+		switch (type)
+		{
+		case GL_UNSIGNED_BYTE: case GL_BYTE:
+			return components;
+		case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT:
+			return components * 2;
+		case GL_UNSIGNED_INT: case GL_INT: case GL_FLOAT:
+			return components * 4;
+		default:
+			throw std::runtime_error("gl::pixelSize unknown type");
+		}
+	}
+	GLsizeiptr rowPitch(GLenum format, GLenum type, GLsizei width, GLint alignment)
+	{
+		const GLsizeiptr row = pixelSize(format, type) * width;
+		return (row + alignment - 1) / alignment * alignment;
 	}
 	Texture::Texture() : Object(), m_target(GL_TEXTURE_2D)
 	{
@@ -166,34 +355,51 @@ namespace gl
 	}
 	void Texture::set_from(GLuint id)
 	{
-		bind();
 		GLint* format = reinterpret_cast<GLint*>(&m_format);
+#if LIBGLW_WITH_DSA
+		glGetTextureLevelParameteriv(id, 0, GL_TEXTURE_INTERNAL_FORMAT, format);
+		glGetTextureLevelParameteriv(id, 0, GL_TEXTURE_WIDTH, &m_size.x);
+		glGetTextureLevelParameteriv(id, 0, GL_TEXTURE_HEIGHT, &m_size.y);
+#else
+		bind();
 		glGetTexLevelParameteriv(m_target, 0, GL_TEXTURE_INTERNAL_FORMAT, format);
 		glGetTexLevelParameteriv(m_target, 0, GL_TEXTURE_WIDTH, &m_size.x);
 		glGetTexLevelParameteriv(m_target, 0, GL_TEXTURE_HEIGHT, &m_size.y);
-
+#endif
+		// Known storage, so that load with the same size only updates the pixels
+		GLint immutable = GL_FALSE, levels = 0;
+#if LIBGLW_WITH_DSA
+		glGetTextureParameteriv(id, GL_TEXTURE_IMMUTABLE_FORMAT, &immutable);
+		glGetTextureParameteriv(id, GL_TEXTURE_IMMUTABLE_LEVELS, &levels);
+#else
+		glGetTexParameteriv(m_target, GL_TEXTURE_IMMUTABLE_FORMAT, &immutable);
+		glGetTexParameteriv(m_target, GL_TEXTURE_IMMUTABLE_LEVELS, &levels);
+#endif
+		m_immutable = immutable == GL_TRUE;
+		m_levels = m_immutable ? levels : (m_size.x > 0 && m_size.y > 0 ? 1 : 0);
+		m_storageSize = m_size;
+		m_storageDepth = m_depth;
+		m_storageFormat = m_format;
 	}
 	void Texture::bind() const
 	{
 		m_sampler.bind();
-		glBindTexture(m_target, id());
+		StateCache::Current().bindTexture(m_target, id());
 	}
 	void Texture::bind(GLuint activeTexture) const
 	{
 		m_sampler.bind(activeTexture);
-		glActiveTexture(GL_TEXTURE0+activeTexture);
-		glBindTexture(m_target, id());
+		StateCache::Current().bindTexture(activeTexture, m_target, id());
 	}
 	void Texture::unbind() const
 	{
 		m_sampler.unbind();
-		glBindTexture(m_target, 0);
+		StateCache::Current().bindTexture(m_target, 0);
 	}
 	void Texture::unbind(GLuint activeTexture) const
 	{
 		m_sampler.unbind(activeTexture);
-		glActiveTexture(GL_TEXTURE0+activeTexture);
-		glBindTexture(m_target, 0);
+		StateCache::Current().bindTexture(activeTexture, m_target, 0);
 	}
 	void Texture::setSize(glm::ivec2 size)
 	{
@@ -230,42 +436,190 @@ namespace gl
 	}
 	void Texture::init_null(GLenum format, GLenum type)
 	{
+		if (isAllocated())
+			return;
+		// A new name would be needed, which framebuffers and holders of id() wouldn't see
+		if (m_immutable)
+			throw std::runtime_error("gl::Texture::init_null can't resize immutable storage, use allocate");
 		bind();
 		glTexImage2D(m_target, 0, m_format, m_size.x, m_size.y, 0, format, type, nullptr);
+		m_levels = 1;
+		m_storageSize = m_size;
+		m_storageDepth = m_depth;
+		m_storageFormat = m_format;
 	}
 	void Texture::load(GLenum format, GLenum type, const GLvoid * data, glm::vec2 newsize)
 	{
-		if (!glIsTexture(id()))
+		if (id() == 0)
 			if (Object::GetAutoInstantiate())
 				instantiate();
 		if (newsize.x != -1 && newsize.y != -1)
 			setSize(newsize);
+		// Same size and format : only the pixels change, the driver keeps the storage
+		if (isAllocated())
+		{
+			update(0, glm::ivec2(0), m_size, format, type, data);
+			return;
+		}
+		if (m_immutable)
+			throw std::runtime_error("gl::Texture::load can't resize immutable storage, use allocate");
+		// Mutable storage, even with DSA : the texture keeps its name when resized
 		bind();
 		glTexImage2D(m_target, 0, m_format, m_size.x, m_size.y, 0, format, type, data);
+		m_levels = 1;
+		m_storageSize = m_size;
+		m_storageDepth = m_depth;
+		m_storageFormat = m_format;
+	}
+	void Texture::loadCompressed(GLenum internalFormat, const GLvoid * data, GLsizei imageSize, glm::ivec2 newsize)
+	{
+		if (id() == 0)
+			if (Object::GetAutoInstantiate())
+				instantiate();
+		if (newsize.x != -1 && newsize.y != -1)
+			setSize(newsize);
+		m_format = internalFormat;
+		if (isAllocated())
+		{
+#if LIBGLW_WITH_DSA
+			glCompressedTextureSubImage2D(id(), 0, 0, 0, m_size.x, m_size.y, m_format, imageSize, data);
+#else
+			bind();
+			glCompressedTexSubImage2D(m_target, 0, 0, 0, m_size.x, m_size.y, m_format, imageSize, data);
+#endif
+			return;
+		}
+		if (m_immutable)
+			throw std::runtime_error("gl::Texture::loadCompressed can't resize immutable storage, use allocate");
+		bind();
+		glCompressedTexImage2D(m_target, 0, m_format, m_size.x, m_size.y, 0, imageSize, data);
+		m_levels = 1;
+		m_storageSize = m_size;
+		m_storageDepth = m_depth;
+		m_storageFormat = m_format;
+	}
+	void Texture::allocate(GLsizei levels, GLenum internalFormat, glm::ivec2 size)
+	{
+		if (size.x <= 0 || size.y <= 0)
+			throw std::runtime_error("gl::Texture::allocate invalid size");
+		if (isLayered(m_target))
+			throw std::runtime_error("gl::Texture::allocate needs a depth for this target");
+		m_size = size;
+		m_depth = 1;
+		m_format = internalFormat;
+		createStorage(levels);
+	}
+	void Texture::allocate(GLsizei levels, GLenum internalFormat, glm::ivec3 size)
+	{
+		if (size.x <= 0 || size.y <= 0 || size.z <= 0)
+			throw std::runtime_error("gl::Texture::allocate invalid size");
+		if (!isLayered(m_target))
+			throw std::runtime_error("gl::Texture::allocate target has no depth");
+		m_size = glm::ivec2(size.x, size.y);
+		m_depth = size.z;
+		m_format = internalFormat;
+		createStorage(levels);
+	}
+	void Texture::update(GLint level, glm::ivec2 offset, glm::ivec2 size, GLenum format, GLenum type, const GLvoid * data)
+	{
+		if (m_levels == 0)
+			throw std::runtime_error("gl::Texture::update texture not allocated");
+		if (m_immutable && level >= m_levels)
+			throw std::runtime_error("gl::Texture::update invalid level");
+#if LIBGLW_WITH_DSA
+		glTextureSubImage2D(id(), level, offset.x, offset.y, size.x, size.y, format, type, data);
+#else
+		bind();
+		glTexSubImage2D(m_target, level, offset.x, offset.y, size.x, size.y, format, type, data);
+#endif
+	}
+	void Texture::update(GLint level, glm::ivec3 offset, glm::ivec3 size, GLenum format, GLenum type, const GLvoid * data)
+	{
+		if (m_levels == 0)
+			throw std::runtime_error("gl::Texture::update texture not allocated");
+		if (m_immutable && level >= m_levels)
+			throw std::runtime_error("gl::Texture::update invalid level");
+#if LIBGLW_WITH_DSA
+		glTextureSubImage3D(id(), level, offset.x, offset.y, offset.z, size.x, size.y, size.z, format, type, data);
+#else
+		bind();
+		glTexSubImage3D(m_target, level, offset.x, offset.y, offset.z, size.x, size.y, size.z, format, type, data);
+#endif
+	}
+	GLsizei Texture::getLevels() const
+	{
+		return m_levels;
+	}
+	bool Texture::isImmutable() const
+	{
+		return m_immutable;
+	}
+	bool Texture::isAllocated() const
+	{
+		return id() != 0 && m_levels > 0 && m_storageSize == m_size && m_storageDepth == m_depth && m_storageFormat == m_format;
 	}
 	void Texture::generateMipmap()
 	{
+#if LIBGLW_WITH_DSA
+		glGenerateTextureMipmap(id());
+#else
 		bind();
 		glGenerateMipmap(m_target);
+#endif
+	}
+	void Texture::createStorage(GLsizei levels)
+	{
+		// Immutable storage can't be respecified, a new texture name is needed
+		if (m_immutable)
+		{
+			destroy();
+			instantiate();
+		}
+		else if (id() == 0)
+			instantiate();
+		const GLsizei fullChain = mipmapLevels(m_target == GL_TEXTURE_3D ? glm::ivec2(glm::max(m_size.x, m_depth), m_size.y) : m_size);
+		m_levels = levels > 0 ? glm::min(levels, fullChain) : fullChain;
+		m_immutable = true;
+		m_storageSize = m_size;
+		m_storageDepth = m_depth;
+		m_storageFormat = m_format;
+		const GLenum format = sizedFormat(m_format);
+#if LIBGLW_WITH_DSA
+		if (isLayered(m_target))
+			glTextureStorage3D(id(), m_levels, format, m_size.x, m_size.y, m_depth);
+		else
+			glTextureStorage2D(id(), m_levels, format, m_size.x, m_size.y);
+#else
+		bind();
+		if (isLayered(m_target))
+			glTexStorage3D(m_target, m_levels, format, m_size.x, m_size.y, m_depth);
+		else
+			glTexStorage2D(m_target, m_levels, format, m_size.x, m_size.y);
+#endif
 	}
 	void Texture::instantiate()
 	{
 		GLuint myid=0;
-		glGenTextures(1, &myid);
-		glBindTexture(m_target, myid);
+		myid = NamePools::Current().textures(m_target).acquire();
+#if LIBGLW_WITH_DSA
+		glTextureParameteri(myid, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTextureParameteri(myid, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+#else
+		StateCache::Current().bindTexture(m_target, myid);
 		glTexParameteri(m_target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 		glTexParameteri(m_target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glBindTexture(m_target, 0);
+		StateCache::Current().bindTexture(m_target, 0);
+#endif
 		setID(myid);
+		m_levels = 0;
+		m_immutable = false;
 		m_sampler.instantiate();
 	}
 
 	void Texture::destroy()
 	{
-		GLuint myid = id();
-		if (glIsTexture(myid))
-			glDeleteTextures(1, &myid);
-		setID(myid);
+		DeletionQueue::Release(DeletionQueue::Kind::Texture, id(), m_target);
+		setID(0);
 	}
 	
 	Framebuffer::Framebuffer() : Object()
@@ -284,7 +638,7 @@ namespace gl
 	}
 	void Framebuffer::BindToScreen(Target target)
 	{
-		glBindFramebuffer(target, 0);
+		StateCache::Current().bindFramebuffer(target, 0);
 	}
 	void Framebuffer::bind() const
 	{
@@ -292,25 +646,36 @@ namespace gl
 	}
 	void Framebuffer::bindTo(Target target) const
 	{
-		glBindFramebuffer(target, id());
+		StateCache::Current().bindFramebuffer(target, id());
 	}
 
 	void Framebuffer::blit(const Framebuffer & fbo, glm::ivec4 src, glm::ivec4 dst, GLbitfield mask, Sampler::Filter filter)
 	{
+#if LIBGLW_WITH_DSA
+		glBlitNamedFramebuffer(fbo.id(), id(), src.x, src.y, src.z, src.w, dst.x, dst.y, dst.z, dst.w, mask, filter);
+#else
 		fbo.bindTo(TargetRead);
 		bindTo(TargetDraw);
 		glBlitFramebuffer(src.x, src.y, src.z, src.w, dst.x, dst.y, dst.z, dst.w, mask, filter);
+#endif
 	}
 
 	void Framebuffer::blitToScreen(glm::ivec4 src, glm::ivec4 dst, GLbitfield mask, Sampler::Filter filter)
 	{
+#if LIBGLW_WITH_DSA
+		glBlitNamedFramebuffer(id(), 0, src.x, src.y, src.z, src.w, dst.x, dst.y, dst.z, dst.w, mask, filter);
+#else
 		bindTo(TargetRead);
-		glBindFramebuffer(TargetDraw, 0);
+		BindToScreen(TargetDraw);
 		glBlitFramebuffer(src.x, src.y, src.z, src.w, dst.x, dst.y, dst.z, dst.w, mask, filter);
+#endif
 	}
 
 	void Framebuffer::attachTexture(Attachment attachment, const Texture & tex, int level_layer)
 	{
+#if LIBGLW_WITH_DSA
+		glNamedFramebufferTexture(id(), attachment, tex.id(), level_layer);
+#else
 		bind();
 		switch(tex.getTarget())
 		{
@@ -321,6 +686,7 @@ namespace gl
 			glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, tex.getTarget(), tex.id(), level_layer);
 			break;
 		}
+#endif
 	}
 
 	void Framebuffer::attachRenderbuffer(Attachment attachment, const RenderBuffer& renderbuffer)
@@ -331,14 +697,22 @@ namespace gl
 
 		m_attachments.emplace(std::make_pair(attachment, RenderBuffer()));
 		m_attachments[attachment].storage<1>(format, m_size);*/
+#if LIBGLW_WITH_DSA
+		glNamedFramebufferRenderbuffer(id(), attachment, GL_RENDERBUFFER, renderbuffer.id());
+#else
 		bind();
 		glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment, GL_RENDERBUFFER, renderbuffer.id());
+#endif
 	}
 
 	GLenum Framebuffer::getStatus()
 	{
+#if LIBGLW_WITH_DSA
+		return glCheckNamedFramebufferStatus(id(), GL_FRAMEBUFFER);
+#else
 		bind();
 		return glCheckFramebufferStatus(GL_FRAMEBUFFER);
+#endif
 	}
 
 	void Framebuffer::clear(GLuint flags)
@@ -347,20 +721,138 @@ namespace gl
 		glClear(flags);
 	}
 
+	void Framebuffer::clearColor(glm::vec4 color, GLint drawbuffer)
+	{
+#if LIBGLW_WITH_DSA
+		glClearNamedFramebufferfv(id(), GL_COLOR, drawbuffer, &color.x);
+#else
+		bind();
+		glClearBufferfv(GL_COLOR, drawbuffer, &color.x);
+#endif
+	}
+
+	void Framebuffer::clearDepth(float depth)
+	{
+#if LIBGLW_WITH_DSA
+		glClearNamedFramebufferfv(id(), GL_DEPTH, 0, &depth);
+#else
+		bind();
+		glClearBufferfv(GL_DEPTH, 0, &depth);
+#endif
+	}
+
+	void Framebuffer::clearStencil(GLint stencil)
+	{
+#if LIBGLW_WITH_DSA
+		glClearNamedFramebufferiv(id(), GL_STENCIL, 0, &stencil);
+#else
+		bind();
+		glClearBufferiv(GL_STENCIL, 0, &stencil);
+#endif
+	}
+
+	Framebuffer::Readback Framebuffer::readAsync(Attachment attachment, glm::ivec4 rect, GLenum format, GLenum type)
+	{
+		if (rect.z <= 0 || rect.w <= 0)
+			throw std::runtime_error("gl::Framebuffer::readAsync invalid rectangle");
+		auto& slot = m_readbacks[m_readback];
+		m_readback = (m_readback + 1) % m_readbacks.size();
+		if (!slot)
+			slot = std::make_shared<ReadbackSlot>();
+		// The previous read of this buffer must be over before it's written again
+		slot->mapping.unmap();
+		slot->fence.wait();
+		++slot->generation;
+		slot->rowPitch = rowPitch(format, type, rect.z);
+		slot->size = slot->rowPitch * rect.w;
+		slot->extent = glm::ivec2(rect.z, rect.w);
+		if (slot->buffer.id() == 0)
+			slot->buffer.instantiate();
+		if (slot->buffer.capacity() < slot->size)
+			slot->buffer.force_reserve(slot->size, GL_STREAM_READ);
+
+		const bool color = attachment >= GL_COLOR_ATTACHMENT0 && attachment <= GL_COLOR_ATTACHMENT31;
+#if LIBGLW_WITH_DSA
+		if (color)
+			glNamedFramebufferReadBuffer(id(), attachment);
+		bindTo(TargetRead);
+#else
+		bindTo(TargetRead);
+		if (color)
+			glReadBuffer(attachment);
+#endif
+		// Bound to GL_PIXEL_PACK_BUFFER, the pixel pointer is an offset in the buffer
+		slot->buffer.bind();
+		// Rows are written as rowPitch reports them, whatever alignment the application uses
+		StateCache::Current().pixelStore(GL_PACK_ALIGNMENT, 4);
+		StateCache::Current().pixelStore(GL_PACK_ROW_LENGTH, 0);
+		glReadPixels(rect.x, rect.y, rect.z, rect.w, format, type, nullptr);
+		slot->buffer.unbind();
+		slot->fence.place();
+		return Readback(slot, slot->generation);
+	}
+	void Framebuffer::setReadbackBuffers(size_t count)
+	{
+		if (count == 0)
+			throw std::runtime_error("gl::Framebuffer::setReadbackBuffers needs a buffer");
+		// Handles keep their buffer alive
+		m_readbacks.assign(count, nullptr);
+		m_readback = 0;
+	}
+	bool Framebuffer::Readback::valid() const
+	{
+		return m_slot && m_slot->generation == m_generation;
+	}
+	bool Framebuffer::Readback::ready()
+	{
+		return slot().fence.isSignaled();
+	}
+	bool Framebuffer::Readback::wait(GLuint64 timeout)
+	{
+		return slot().fence.wait(timeout);
+	}
+	const unsigned char* Framebuffer::Readback::data()
+	{
+		ReadbackSlot& readback = slot();
+		if (!readback.mapping)
+		{
+			readback.fence.wait();
+			readback.mapping = readback.buffer.map_range(0, readback.size, GL_MAP_READ_BIT);
+			readback.buffer.unbind();
+		}
+		return readback.mapping.data();
+	}
+	GLsizeiptr Framebuffer::Readback::size() const
+	{
+		return slot().size;
+	}
+	GLsizeiptr Framebuffer::Readback::rowPitch() const
+	{
+		return slot().rowPitch;
+	}
+	glm::ivec2 Framebuffer::Readback::extent() const
+	{
+		return slot().extent;
+	}
+	Framebuffer::ReadbackSlot& Framebuffer::Readback::slot() const
+	{
+		if (!valid())
+			throw std::runtime_error("gl::Framebuffer::Readback buffer reused by another read");
+		return *m_slot;
+	}
+
 	void Framebuffer::instantiate()
 	{
 		GLuint myid = id();
-		if (!glIsFramebuffer(myid))
-			glGenFramebuffers(1, &myid);
+		if (myid == 0)
+			myid = NamePools::Current().framebuffers.acquire();
 		setID(myid);
 	}
 
 	void Framebuffer::destroy()
 	{
-		GLuint myID = id();
-		if (glIsFramebuffer(myID))
-			glDeleteFramebuffers(1, &myID);
-		setID(myID);
+		DeletionQueue::Release(DeletionQueue::Kind::Framebuffer, id());
+		setID(0);
 	}
 
 	RenderBuffer::RenderBuffer() : Object()
@@ -381,23 +873,21 @@ namespace gl
 
 	void RenderBuffer::bind() const
 	{
-		glBindRenderbuffer(GL_RENDERBUFFER, id());
+		StateCache::Current().bindRenderbuffer(id());
 	}
 
 	void RenderBuffer::instantiate()
 	{
 		GLuint myID = id();
-		if (!glIsRenderbuffer(myID))
-			glGenRenderbuffers(1, &myID);
+		if (myID == 0)
+			myID = NamePools::Current().renderbuffers.acquire();
 		setID(myID);
 	}
 
 	void RenderBuffer::destroy()
 	{
-		GLuint myID = id();
-		if (glIsRenderbuffer(myID))
-			glDeleteRenderbuffers(1, &myID);
-		setID(myID);
+		DeletionQueue::Release(DeletionQueue::Kind::Renderbuffer, id());
+		setID(0);
 	}
 	template <>
 	void RenderBuffer::storage<1>(GLenum internalformat, glm::ivec2 newsize)
@@ -406,8 +896,12 @@ namespace gl
 			instantiate();
 		if (newsize.x != -1 && newsize.y != -1)
 			setSize(newsize);
+#if LIBGLW_WITH_DSA
+		glNamedRenderbufferStorage(id(), internalformat, m_size.x, m_size.y);
+#else
 		bind();
 		glRenderbufferStorage(GL_RENDERBUFFER, internalformat, m_size.x, m_size.y);
+#endif
 	}
 
 	VertexArray::VertexArray() : Object()
@@ -416,51 +910,93 @@ namespace gl
 			instantiate();
 	}
 
-	VertexArray::VertexArray(GLuint id) : Object(id)
+	VertexArray::VertexArray(GLuint id) : Object(id), m_known(0)
 	{
 	}
 	VertexArray::~VertexArray()
 	{
 		destroy();
 	}
+	uint32_t VertexArray::attribBit(int index)
+	{
+		if (index < 0 || index >= MaxAttribs)
+			throw std::runtime_error("gl::VertexArray invalid attribute index");
+		return 1u << index;
+	}
+
 	void VertexArray::enable(int index)
 	{
+		const uint32_t bit = attribBit(index);
+#if LIBGLW_WITH_DSA
+		glEnableVertexArrayAttrib(id(), index);
+#else
 		bind();
 		glEnableVertexAttribArray(index);
+#endif
+		m_enabled |= bit;
+		m_known |= bit;
 	}
 
 	void VertexArray::disable(int index)
 	{
+		const uint32_t bit = attribBit(index);
+#if LIBGLW_WITH_DSA
+		glDisableVertexArrayAttrib(id(), index);
+#else
 		bind();
 		glDisableVertexAttribArray(index);
+#endif
+		m_enabled &= ~bit;
+		m_known |= bit;
 	}
 
 	bool VertexArray::isEnabled(int index) const
+	{
+		const uint32_t bit = attribBit(index);
+		if (!(m_known & bit))
+		{
+			if (queryEnabled(index))
+				m_enabled |= bit;
+			m_known |= bit;
+		}
+		const bool enabled = (m_enabled & bit) != 0;
+#if LIBGLW_WITH_STATE_CHECK
+		assert(enabled == queryEnabled(index) && "gl::VertexArray enabled attributes out of sync");
+#endif
+		return enabled;
+	}
+
+	bool VertexArray::queryEnabled(int index) const
 	{
 		int res;
+#if LIBGLW_WITH_DSA
+		glGetVertexArrayIndexediv(id(), index, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &res);
+#else
+		bind();
 		glGetVertexAttribiv(index, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &res);
-		return res;
+#endif
+		return res != 0;
 	}
 
 	void VertexArray::bind() const
 	{
-		glBindVertexArray(id());
+		StateCache::Current().bindVertexArray(id());
 	}
 
 	void VertexArray::instantiate()
 	{
 		GLuint myID = id();
-		if (!glIsVertexArray(myID))
-			glGenVertexArrays(1, &myID);
+		if (myID == 0)
+			myID = NamePools::Current().vertexArrays.acquire();
 		setID(myID);
 	}
 
 	void VertexArray::destroy()
 	{
-		GLuint myID = id();
-		if (glIsVertexArray(myID))
-			glDeleteVertexArrays(1, &myID);
-		setID(myID);
+		DeletionQueue::Release(DeletionQueue::Kind::VertexArray, id());
+		setID(0);
+		m_enabled = 0;
+		m_known = ~0u;
 	}
 
 }
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include <libglw/NamePool.h>
+#include <libglw/StateCache.h>
+#include <stdexcept>
+#include <tuple>
+namespace gl
+{
+	namespace
+	{
+		thread_local NamePools* t_currentPools = nullptr;
+
+		NamePools& defaultPools()
+		{
+			thread_local NamePools pools;
+			return pools;
+		}
+	}
+	NamePool::NamePool(Generator generator, Deleter deleter, GLsizei block_size) : m_generator(std::move(generator)), m_deleter(std::move(deleter))
+	{
+		setBlockSize(block_size);
+	}
+	GLuint NamePool::acquire()
+	{
+		if (m_free.empty())
+			reserve(m_blockSize);
+		GLuint name = m_free.back();
+		m_free.pop_back();
+		return name;
+	}
+	void NamePool::release(GLuint name)
+	{
+		if (name == 0)
+			return;
+		m_released.push_back(name);
+		if (static_cast<GLsizei>(m_released.size()) >= m_blockSize)
+			flush();
+	}
+	void NamePool::reserve(GLsizei count)
+	{
+		if (count <= available())
+			return;
+		const GLsizei missing = count - available();
+		const size_t first = m_free.size();
+		m_free.resize(first + missing);
+		m_generator(missing, m_free.data() + first);
+	}
+	void NamePool::flush()
+	{
+		if (m_released.empty())
+			return;
+		m_deleter(static_cast<GLsizei>(m_released.size()), m_released.data());
+		m_released.clear();
+	}
+	void NamePool::clear()
+	{
+		flush();
+		if (!m_free.empty())
+			m_deleter(static_cast<GLsizei>(m_free.size()), m_free.data());
+		m_free.clear();
+	}
+	void NamePool::setBlockSize(GLsizei block_size)
+	{
+		if (block_size <= 0)
+			throw std::runtime_error("gl::NamePool invalid block size");
+		m_blockSize = block_size;
+	}
+
+	NamePools::NamePools() :
+#if LIBGLW_WITH_DSA
+		buffers([](GLsizei n, GLuint* names) { glCreateBuffers(n, names); },
+#else
+		buffers([](GLsizei n, GLuint* names) { glGenBuffers(n, names); },
+#endif
+			[](GLsizei n, const GLuint* names) {
+				glDeleteBuffers(n, names);
+				for (GLsizei i = 0; i < n; ++i)
+					StateCache::Current().deletedBuffer(names[i]);
+			}),
+#if LIBGLW_WITH_DSA
+		vertexArrays([](GLsizei n, GLuint* names) { glCreateVertexArrays(n, names); },
+#else
+		vertexArrays([](GLsizei n, GLuint* names) { glGenVertexArrays(n, names); },
+#endif
+			[](GLsizei n, const GLuint* names) {
+				glDeleteVertexArrays(n, names);
+				for (GLsizei i = 0; i < n; ++i)
+					StateCache::Current().deletedVertexArray(names[i]);
+			}),
+#if LIBGLW_WITH_DSA
+		samplers([](GLsizei n, GLuint* names) { glCreateSamplers(n, names); },
+#else
+		samplers([](GLsizei n, GLuint* names) { glGenSamplers(n, names); },
+#endif
+			[](GLsizei n, const GLuint* names) {
+				glDeleteSamplers(n, names);
+				for (GLsizei i = 0; i < n; ++i)
+					StateCache::Current().deletedSampler(names[i]);
+			}),
+#if LIBGLW_WITH_DSA
+		framebuffers([](GLsizei n, GLuint* names) { glCreateFramebuffers(n, names); },
+#else
+		framebuffers([](GLsizei n, GLuint* names) { glGenFramebuffers(n, names); },
+#endif
+			[](GLsizei n, const GLuint* names) {
+				glDeleteFramebuffers(n, names);
+				for (GLsizei i = 0; i < n; ++i)
+					StateCache::Current().deletedFramebuffer(names[i]);
+			}),
+#if LIBGLW_WITH_DSA
+		renderbuffers([](GLsizei n, GLuint* names) { glCreateRenderbuffers(n, names); },
+#else
+		renderbuffers([](GLsizei n, GLuint* names) { glGenRenderbuffers(n, names); },
+#endif
+			[](GLsizei n, const GLuint* names) {
+				glDeleteRenderbuffers(n, names);
+				for (GLsizei i = 0; i < n; ++i)
+					StateCache::Current().deletedRenderbuffer(names[i]);
+			}),
+#if LIBGLW_WITH_DSA
+		programPipelines([](GLsizei n, GLuint* names) { glCreateProgramPipelines(n, names); },
+#else
+		programPipelines([](GLsizei n, GLuint* names) { glGenProgramPipelines(n, names); },
+#endif
+			[](GLsizei n, const GLuint* names) {
+				glDeleteProgramPipelines(n, names);
+				for (GLsizei i = 0; i < n; ++i)
+					StateCache::Current().deletedProgramPipeline(names[i]);
+			})
+	{
+	}
+	NamePools& NamePools::Current()
+	{
+		return t_currentPools ? *t_currentPools : defaultPools();
+	}
+	void NamePools::MakeCurrent(NamePools* pools)
+	{
+		t_currentPools = pools;
+	}
+	NamePool& NamePools::textures(GLenum target)
+	{
+#if !LIBGLW_WITH_DSA
+		// Generated names get their target on first bind
+		target = 0;
+#endif
+		auto it = m_textures.find(target);
+		if (it == m_textures.end())
+		{
+			auto deleter = [](GLsizei n, const GLuint* names) {
+				glDeleteTextures(n, names);
+				for (GLsizei i = 0; i < n; ++i)
+					StateCache::Current().deletedTexture(names[i]);
+			};
+#if LIBGLW_WITH_DSA
+			auto generator = [target](GLsizei n, GLuint* names) { glCreateTextures(target, n, names); };
+#else
+			auto generator = [](GLsizei n, GLuint* names) { glGenTextures(n, names); };
+#endif
+			it = m_textures.emplace(std::piecewise_construct, std::forward_as_tuple(target), std::forward_as_tuple(generator, deleter)).first;
+		}
+		return it->second;
+	}
+	void NamePools::flush()
+	{
+		buffers.flush();
+		vertexArrays.flush();
+		samplers.flush();
+		framebuffers.flush();
+		renderbuffers.flush();
+		programPipelines.flush();
+		for (auto& pool : m_textures)
+			pool.second.flush();
+	}
+	void NamePools::clear()
+	{
+		buffers.clear();
+		vertexArrays.clear();
+		samplers.clear();
+		framebuffers.clear();
+		renderbuffers.clear();
+		programPipelines.clear();
+		for (auto& pool : m_textures)
+			pool.second.clear();
+	}
+}
@@ -0,0 +1,228 @@
+#include <libglw/ProgramCache.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+namespace gl
+{
+	namespace sl
+	{
+		namespace
+		{
+			constexpr char Magic[4] = { 'G', 'L', 'W', 'B' };
+
+			/// 64 bit FNV-1a, chained
+			uint64_t hash(uint64_t value, const void* data, size_t size)
+			{
+				const unsigned char* bytes = static_cast<const unsigned char*>(data);
+				for (size_t i = 0; i < size; ++i)
+					value = (value ^ bytes[i]) * 1099511628211ull;
+				return value;
+			}
+			/// Hash a string with its size, so that concatenations don't collide
+			uint64_t hash(uint64_t value, const std::string& str)
+			{
+				const uint64_t size = str.size();
+				value = hash(value, &size, sizeof(size));
+				return hash(value, str.data(), str.size());
+			}
+			std::string driverString(GLenum name)
+			{
+				const GLubyte* str = glGetString(name);
+				return str ? reinterpret_cast<const char*>(str) : "";
+			}
+			template <TypeShader type>
+			GLuint attachSource(Program& program, const std::string& code)
+			{
+				gl::sl::Shader<type> shader(code, false);
+				program.attachShader(shader);
+				return shader.id();
+			}
+			/// Compile and attach a stage, return the shader to release after the link (~Shader doesn't delete it)
+			GLuint attachSource(Program& program, TypeShader type, const std::string& code)
+			{
+				switch (type)
+				{
+				case gl::sl::Vertex: return attachSource<gl::sl::Vertex>(program, code);
+				case gl::sl::Fragment: return attachSource<gl::sl::Fragment>(program, code);
+				case gl::sl::Geometry: return attachSource<gl::sl::Geometry>(program, code);
+				case gl::sl::Compute: return attachSource<gl::sl::Compute>(program, code);
+				default: throw std::runtime_error("gl::sl::ProgramCache unknown shader type");
+				}
+			}
+			/// The linked program doesn't need its shaders anymore
+			void releaseShaders(Program& program, const std::vector<GLuint>& shaders)
+			{
+				for (GLuint shader : shaders)
+				{
+					program.detachShader(shader);
+					DeletionQueue::Release(DeletionQueue::Kind::Shader, shader);
+				}
+			}
+			template <typename T>
+			void writeValue(std::ostream& stream, const T& value)
+			{
+				stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+			}
+			template <typename T>
+			bool readValue(std::istream& stream, T& value)
+			{
+				return static_cast<bool>(stream.read(reinterpret_cast<char*>(&value), sizeof(T)));
+			}
+		}
+		ProgramCache::ProgramCache(std::string directory) : m_directory(std::move(directory))
+		{
+#if LIBGLW_WITH_STD_FILESYSTEM
+			std::error_code error;
+			std::filesystem::create_directories(m_directory, error);
+#endif
+		}
+		std::string ProgramCache::InjectDefines(const std::string& code, const std::vector<std::string>& defines)
+		{
+			if (defines.empty())
+				return code;
+			// The defines go after #version, which must be the first directive
+			size_t insert = 0;
+			size_t version = code.find("#version");
+			if (version != std::string::npos)
+			{
+				insert = code.find('\n', version);
+				insert = insert == std::string::npos ? code.size() : insert + 1;
+			}
+			const size_t nextLine = std::count(code.begin(), code.begin() + insert, '\n') + 1;
+			std::string result = code.substr(0, insert);
+			if (!result.empty() && result.back() != '\n')
+				result += '\n';
+			for (const auto& define : defines)
+				result += "#define " + define + '\n';
+			result += "#line " + std::to_string(nextLine) + '\n';
+			result.append(code, insert, std::string::npos);
+			return result;
+		}
+		void ProgramCache::build(Program& program, const std::vector<Source>& sources, const std::vector<std::string>& defines)
+		{
+			const bool cached = m_enabled && supported();
+			uint64_t programKey = 0;
+			if (cached)
+			{
+				programKey = key(sources, defines);
+				if (load(program, programKey))
+				{
+					++m_stats.hits;
+					return;
+				}
+			}
+			++m_stats.misses;
+			std::vector<GLuint> shaders;
+			try
+			{
+				for (const auto& source : sources)
+					shaders.push_back(attachSource(program, source.type, InjectDefines(source.code, defines)));
+				if (cached)
+					program.setBinaryRetrievable(true);
+				program.link();
+			}
+			catch (...)
+			{
+				releaseShaders(program, shaders);
+				throw;
+			}
+			releaseShaders(program, shaders);
+			if (cached)
+				store(program, programKey);
+		}
+		uint64_t ProgramCache::key(const std::vector<Source>& sources, const std::vector<std::string>& defines)
+		{
+			supported();
+			uint64_t value = 14695981039346656037ull;
+			value = hash(value, m_driver);
+			for (const auto& source : sources)
+			{
+				const uint32_t type = source.type;
+				value = hash(value, &type, sizeof(type));
+				value = hash(value, source.code);
+			}
+			for (const auto& define : defines)
+				value = hash(value, define);
+			return value;
+		}
+		bool ProgramCache::supported()
+		{
+			if (!m_queried)
+			{
+				m_queried = true;
+				m_driver = driverString(GL_VENDOR) + '\n' + driverString(GL_RENDERER) + '\n' + driverString(GL_VERSION);
+				GLint formats = 0;
+				if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)
+					glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+				m_supported = formats > 0;
+			}
+			return m_supported;
+		}
+		std::string ProgramCache::path(uint64_t key) const
+		{
+			std::ostringstream ostr;
+			ostr << m_directory;
+			if (!m_directory.empty() && m_directory.back() != '/' && m_directory.back() != '\\')
+				ostr << '/';
+			ostr << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+			return ostr.str();
+		}
+		bool ProgramCache::load(Program& program, uint64_t key)
+		{
+			const std::string file = path(key);
+			std::ifstream stream(file, std::ios::binary);
+			if (!stream)
+				return false;
+			char magic[4];
+			uint64_t storedKey = 0;
+			uint32_t format = 0, length = 0;
+			std::vector<char> binary;
+			bool valid = readValue(stream, magic) && std::equal(magic, magic + 4, Magic)
+				&& readValue(stream, storedKey) && storedKey == key
+				&& readValue(stream, format) && readValue(stream, length) && length > 0;
+			if (valid)
+			{
+				binary.resize(length);
+				valid = static_cast<bool>(stream.read(binary.data(), length));
+			}
+			stream.close();
+			if (valid && program.loadBinary(format, binary.data(), static_cast<GLsizei>(length)))
+				return true;
+			// Truncated, or built by another driver : build it again
+			++m_stats.rejected;
+			std::remove(file.c_str());
+			return false;
+		}
+		void ProgramCache::store(const Program& program, uint64_t key) const
+		{
+			GLenum format = GL_NONE;
+			std::vector<char> binary = program.binary(format);
+			if (binary.empty())
+				return;
+			// Written aside then renamed, so that a crash never leaves a truncated binary
+			const std::string file = path(key);
+			const std::string temporary = file + ".tmp";
+			{
+				std::ofstream stream(temporary, std::ios::binary | std::ios::trunc);
+				if (!stream)
+					return;
+				stream.write(Magic, sizeof(Magic));
+				writeValue(stream, key);
+				writeValue(stream, static_cast<uint32_t>(format));
+				writeValue(stream, static_cast<uint32_t>(binary.size()));
+				stream.write(binary.data(), binary.size());
+				if (!stream)
+				{
+					stream.close();
+					std::remove(temporary.c_str());
+					return;
+				}
+			}
+			std::remove(file.c_str());
+			if (std::rename(temporary.c_str(), file.c_str()) != 0)
+				std::remove(temporary.c_str());
+		}
+	}
+}
@@ -0,0 +1,204 @@
+#include <libglw/ShaderVariants.h>
+#include <libglw/ProgramCache.h>
+#include <sstream>
+namespace gl
+{
+	namespace sl
+	{
+		namespace
+		{
+			/// Shaders compiled by the managers of the thread (its context), shared when their source is identical
+			class SharedShaders
+			{
+			public:
+				/// Shader compiled from this source, 0 if none. A found shader gets one more user.
+				GLuint acquire(TypeShader type, const std::string& code)
+				{
+					auto it = m_shaders.find(key(type, code));
+					if (it == m_shaders.end())
+						return 0;
+					++it->second.users;
+					return it->second.id;
+				}
+				void add(TypeShader type, const std::string& code, GLuint id)
+				{
+					auto it = m_shaders.emplace(key(type, code), Entry{id, 1}).first;
+					m_keys.emplace(id, &it->first);
+				}
+				/// Delete the shader once its last user releases it
+				void release(GLuint id)
+				{
+					auto key = m_keys.find(id);
+					if (key == m_keys.end())
+						return;
+					auto it = m_shaders.find(*key->second);
+					if (--it->second.users != 0)
+						return;
+					m_keys.erase(key);
+					m_shaders.erase(it);
+					DeletionQueue::Release(DeletionQueue::Kind::Shader, id);
+				}
+			private:
+				struct Entry
+				{
+					GLuint id;
+					size_t users;
+				};
+				static std::string key(TypeShader type, const std::string& code)
+				{
+					std::string result = std::to_string(type);
+					result += '\n';
+					result += code;
+					return result;
+				}
+				std::unordered_map<std::string, Entry> m_shaders;
+				/// Keys of the shaders, pointing in m_shaders
+				std::unordered_map<GLuint, const std::string*> m_keys;
+			};
+			SharedShaders& sharedShaders()
+			{
+				thread_local SharedShaders shaders;
+				return shaders;
+			}
+		}
+		ShaderVariants::ShaderVariants(std::vector<Source> sources, std::string name) : m_name(std::move(name))
+		{
+			m_stages.reserve(sources.size());
+			for (auto& source : sources)
+			{
+				Stage stage;
+				stage.source = std::move(source);
+				m_stages.push_back(std::move(stage));
+			}
+		}
+		ShaderVariants::~ShaderVariants()
+		{
+			clear();
+		}
+		ShaderVariants::Mask ShaderVariants::addFlag(std::string define)
+		{
+			std::vector<std::string> defines;
+			defines.push_back(std::move(define));
+			return addKey(std::move(defines), 1, true);
+		}
+		ShaderVariants::Choice ShaderVariants::addChoice(std::vector<std::string> defines)
+		{
+			if (defines.empty())
+				throw std::runtime_error("gl::sl::ShaderVariants::addChoice without define");
+			unsigned bits = 0;
+			while ((size_t(1) << bits) < defines.size())
+				++bits;
+			const size_t count = defines.size();
+			const unsigned shift = m_bits;
+			addKey(std::move(defines), bits, false);
+			return Choice(shift, count);
+		}
+		ShaderVariants::Mask ShaderVariants::addKey(std::vector<std::string> defines, unsigned bits, bool flag)
+		{
+			if (m_bits + bits > 64)
+				throw std::runtime_error("gl::sl::ShaderVariants too many keys for a 64 bits mask");
+			if (!m_programs.empty())
+				throw std::runtime_error("gl::sl::ShaderVariants keys must be added before the first variant");
+			Key key{std::move(defines), m_bits, bits, flag};
+			m_bits += bits;
+			// A stage not naming any define of the key is the same for all its values
+			for (auto& stage : m_stages)
+				for (const auto& define : key.defines)
+				{
+					const std::string name = define.substr(0, define.find(' '));
+					if (stage.source.code.find(name) != std::string::npos)
+					{
+						stage.used |= key.mask();
+						break;
+					}
+				}
+			m_keys.push_back(std::move(key));
+			return m_keys.back().mask();
+		}
+		std::vector<std::string> ShaderVariants::defines(Mask mask) const
+		{
+			const Mask known = m_bits == 64 ? ~Mask(0) : (Mask(1) << m_bits) - 1;
+			if (mask & ~known)
+				throw std::runtime_error("gl::sl::ShaderVariants unknown bits in the mask");
+			std::vector<std::string> result;
+			for (const auto& key : m_keys)
+			{
+				const size_t value = static_cast<size_t>((mask & key.mask()) >> key.shift);
+				// A choice always defines one of its values
+				if (key.flag)
+				{
+					if (value)
+						result.push_back(key.defines[0]);
+				}
+				else if (value < key.defines.size())
+					result.push_back(key.defines[value]);
+				else
+					throw std::runtime_error("gl::sl::ShaderVariants choice value out of range");
+			}
+			return result;
+		}
+		Program& ShaderVariants::get(Mask mask)
+		{
+			auto it = m_programs.find(mask);
+			if (it != m_programs.end())
+				return *it->second;
+			std::unique_ptr<Program> program(new Program());
+			for (auto& stage : m_stages)
+				program->attachShader(shader(stage, mask));
+			program->link();
+			++m_stats.programs;
+			return *m_programs.emplace(mask, std::move(program)).first->second;
+		}
+		GLuint ShaderVariants::shader(Stage& stage, Mask mask)
+		{
+			const Mask used = mask & stage.used;
+			auto it = stage.shaders.find(used);
+			if (it != stage.shaders.end())
+			{
+				++m_stats.shared;
+				return it->second;
+			}
+			const std::string code = ProgramCache::InjectDefines(stage.source.code, defines(used));
+			// Another manager may have compiled the same source
+			GLuint id = sharedShaders().acquire(stage.source.type, code);
+			if (id != 0)
+			{
+				++m_stats.shared;
+				stage.shaders.emplace(used, id);
+				return id;
+			}
+			id = glCreateShader(stage.source.type);
+			if (id == 0)
+				throw std::runtime_error("gl::sl::ShaderVariants unknown shader type");
+			const GLchar* source = code.c_str();
+			glShaderSource(id, 1, &source, nullptr);
+			glCompileShader(id);
+			++m_stats.compiles;
+			GLint status(0);
+			glGetShaderiv(id, GL_COMPILE_STATUS, &status);
+			if (status != GL_TRUE)
+			{
+				std::ostringstream name;
+				name << m_name << " (variant 0x" << std::hex << mask << ')';
+				// The exception deletes the shader
+				throw CompileException(stage.source.type, name.str(), id);
+			}
+			sharedShaders().add(stage.source.type, code, id);
+			stage.shaders.emplace(used, id);
+			return id;
+		}
+		void ShaderVariants::clear()
+		{
+			// ~Program doesn't delete the name
+			for (auto& program : m_programs)
+				program.second->destroy();
+			m_programs.clear();
+			for (auto& stage : m_stages)
+			{
+				for (auto& shader : stage.shaders)
+					sharedShaders().release(shader.second);
+				stage.shaders.clear();
+			}
+		}
+	}
+}
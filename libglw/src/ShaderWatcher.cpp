@@ -0,0 +1,330 @@
+#include <libglw/ShaderWatcher.h>
+#include <algorithm>
+#ifdef __linux__
+#	include <sys/inotify.h>
+#	include <unistd.h>
+#endif
+namespace gl
+{
+	namespace sl
+	{
+		namespace
+		{
+			thread_local ShaderWatcher* t_currentWatcher = nullptr;
+
+			/// Directory of a normalized path, with its final '/'
+			std::string directory(const std::string& path)
+			{
+				size_t slash = path.rfind('/');
+				return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+			}
+		}
+		ShaderWatcher::ShaderWatcher()
+		{
+#ifdef __linux__
+			m_notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+		}
+		ShaderWatcher::~ShaderWatcher()
+		{
+			for (auto& program : m_programs)
+			{
+				program.first->m_watcher = nullptr;
+				releaseShaders(program.second);
+			}
+#ifdef __linux__
+			if (m_notify >= 0)
+				close(m_notify);
+#endif
+			if (t_currentWatcher == this)
+				t_currentWatcher = nullptr;
+		}
+		ShaderWatcher* ShaderWatcher::Current()
+		{
+			return t_currentWatcher;
+		}
+		void ShaderWatcher::MakeCurrent(ShaderWatcher* watcher)
+		{
+			t_currentWatcher = watcher;
+		}
+		void ShaderWatcher::watch(Program& program)
+		{
+			if (program.m_watcher && program.m_watcher != this)
+				program.m_watcher->unwatch(program);
+			auto it = m_programs.find(&program);
+			if (it != m_programs.end())
+			{
+				removeDependencies(program, it->second);
+				releaseShaders(it->second);
+			}
+			std::vector<Stage> stages;
+			for (const auto& file : program.m_files)
+			{
+				Stage stage;
+				stage.type = file.type;
+				stage.path = file.path;
+				try
+				{
+					stage.files = SourceLoader::Global().files(file.path);
+				}
+				catch (const std::runtime_error&)
+				{
+					stage.files.push_back(SourceLoader::Normalize(file.path));
+				}
+				stages.push_back(std::move(stage));
+			}
+			addDependencies(program, stages);
+			m_programs[&program] = std::move(stages);
+			program.m_watcher = this;
+		}
+		void ShaderWatcher::unwatch(Program& program)
+		{
+			auto it = m_programs.find(&program);
+			if (it != m_programs.end())
+			{
+				removeDependencies(program, it->second);
+				releaseShaders(it->second);
+				m_programs.erase(it);
+			}
+			if (program.m_watcher == this)
+				program.m_watcher = nullptr;
+		}
+		void ShaderWatcher::swapped(Program& first, Program& second)
+		{
+			std::vector<Stage> firstStages, secondStages;
+			auto it = m_programs.find(&first);
+			const bool hasFirst = it != m_programs.end();
+			if (hasFirst)
+			{
+				removeDependencies(first, it->second);
+				firstStages = std::move(it->second);
+				m_programs.erase(it);
+			}
+			it = m_programs.find(&second);
+			const bool hasSecond = it != m_programs.end();
+			if (hasSecond)
+			{
+				removeDependencies(second, it->second);
+				secondStages = std::move(it->second);
+				m_programs.erase(it);
+			}
+			if (hasFirst)
+			{
+				addDependencies(second, firstStages);
+				m_programs[&second] = std::move(firstStages);
+			}
+			if (hasSecond)
+			{
+				addDependencies(first, secondStages);
+				m_programs[&first] = std::move(secondStages);
+			}
+		}
+		size_t ShaderWatcher::poll()
+		{
+			const std::set<std::string> changed = changes();
+			if (changed.empty())
+				return 0;
+			std::set<Program*> affected;
+			for (const auto& file : changed)
+			{
+				auto it = m_dependents.find(file);
+				if (it != m_dependents.end())
+					affected.insert(it->second.begin(), it->second.end());
+			}
+			size_t count = 0;
+			for (Program* program : affected)
+			{
+				// A listener may have unwatched it
+				auto it = m_programs.find(program);
+				if (it != m_programs.end() && reload(*program, it->second, changed))
+					++count;
+			}
+			return count;
+		}
+		bool ShaderWatcher::reload(Program& program, std::vector<Stage>& stages, const std::set<std::string>& changed)
+		{
+			SourceLoader& loader = SourceLoader::Global();
+			std::vector<bool> dirty(stages.size());
+			std::vector<GLuint> compiled(stages.size(), 0);
+			std::vector<std::vector<std::string>> files(stages.size());
+			for (size_t i = 0; i < stages.size(); ++i)
+				dirty[i] = stages[i].shader == 0 || std::any_of(stages[i].files.begin(), stages[i].files.end(), [&changed](const std::string& file) {
+					return changed.count(file) != 0;
+				});
+
+			// Only the stages including a modified file are compiled again
+			std::string error;
+			for (size_t i = 0; i < stages.size() && error.empty(); ++i)
+			{
+				if (!dirty[i])
+					continue;
+				try
+				{
+					const std::string& code = loader.load(stages[i].path);
+					files[i] = loader.files(stages[i].path);
+					const GLchar* source = code.c_str();
+					compiled[i] = glCreateShader(stages[i].type);
+					glShaderSource(compiled[i], 1, &source, nullptr);
+					glCompileShader(compiled[i]);
+					++m_stats.compiles;
+					GLint status(0);
+					glGetShaderiv(compiled[i], GL_COMPILE_STATUS, &status);
+					if (status != GL_TRUE)
+						error = "\nErreur de compilation du shader\nNom du Shader : " + stages[i].path + "\nErreur :\n" + shaderInfoLog(compiled[i]);
+				}
+				catch (const std::runtime_error& exc)
+				{
+					error = exc.what();
+				}
+			}
+			GLuint id = 0;
+			if (error.empty())
+			{
+				id = glCreateProgram();
+				for (size_t i = 0; i < stages.size(); ++i)
+					glAttachShader(id, compiled[i] ? compiled[i] : stages[i].shader);
+				// The parameters are set before the link, as the previous program got them
+				GLint parameter(GL_FALSE);
+				if (GLEW_VERSION_4_1 || GLEW_ARB_separate_shader_objects)
+				{
+					glGetProgramiv(program.id(), GL_PROGRAM_SEPARABLE, &parameter);
+					glProgramParameteri(id, GL_PROGRAM_SEPARABLE, parameter);
+				}
+				if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)
+				{
+					glGetProgramiv(program.id(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, &parameter);
+					glProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, parameter);
+				}
+				glLinkProgram(id);
+				GLint status(0);
+				glGetProgramiv(id, GL_LINK_STATUS, &status);
+				if (status != GL_TRUE)
+					error = "\nErreur lors du link du program\nErreur :\n" + programInfoLog(id);
+				for (size_t i = 0; i < stages.size(); ++i)
+					glDetachShader(id, compiled[i] ? compiled[i] : stages[i].shader);
+				if (!error.empty())
+					DeletionQueue::Release(DeletionQueue::Kind::Program, id);
+			}
+
+			removeDependencies(program, stages);
+			if (!error.empty())
+			{
+				// The program keeps its name. Dirty stages are compiled again next time, and the new includes are watched too.
+				for (size_t i = 0; i < stages.size(); ++i)
+				{
+					DeletionQueue::Release(DeletionQueue::Kind::Shader, compiled[i]);
+					if (!dirty[i])
+						continue;
+					DeletionQueue::Release(DeletionQueue::Kind::Shader, stages[i].shader);
+					stages[i].shader = 0;
+					for (auto& file : files[i])
+						if (std::find(stages[i].files.begin(), stages[i].files.end(), file) == stages[i].files.end())
+							stages[i].files.push_back(file);
+				}
+				addDependencies(program, stages);
+				++m_stats.failures;
+				m_lastError = error;
+				if (m_listener)
+					m_listener(program, error);
+				return false;
+			}
+			for (size_t i = 0; i < stages.size(); ++i)
+			{
+				if (!compiled[i])
+					continue;
+				DeletionQueue::Release(DeletionQueue::Kind::Shader, stages[i].shader);
+				stages[i].shader = compiled[i];
+				stages[i].files = std::move(files[i]);
+			}
+			addDependencies(program, stages);
+			program.replace(id);
+			++m_stats.reloads;
+			if (m_listener)
+				m_listener(program, error);
+			return true;
+		}
+		void ShaderWatcher::addDependencies(Program& program, const std::vector<Stage>& stages)
+		{
+			for (const auto& stage : stages)
+				for (const auto& file : stage.files)
+				{
+					auto& dependents = m_dependents[file];
+					if (dependents.empty())
+						watchFile(file);
+					dependents.insert(&program);
+				}
+		}
+		void ShaderWatcher::removeDependencies(Program& program, const std::vector<Stage>& stages)
+		{
+			for (const auto& stage : stages)
+				for (const auto& file : stage.files)
+				{
+					auto it = m_dependents.find(file);
+					if (it == m_dependents.end())
+						continue;
+					it->second.erase(&program);
+					if (it->second.empty())
+					{
+						m_dependents.erase(it);
+						m_times.erase(file);
+					}
+				}
+		}
+		void ShaderWatcher::watchFile(const std::string& path)
+		{
+#ifdef __linux__
+			if (m_notify >= 0)
+			{
+				// Editors often save by replacing the file : watch its directory
+				const std::string dir = directory(path);
+				int wd = inotify_add_watch(m_notify, dir.empty() ? "." : dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+				if (wd >= 0)
+					m_directories[wd] = dir;
+				return;
+			}
+#endif
+			int64_t time = 0;
+			if (SourceLoader::ModificationTime(path, time))
+				m_times.emplace(path, time);
+		}
+		std::set<std::string> ShaderWatcher::changes()
+		{
+			std::set<std::string> changed;
+#ifdef __linux__
+			if (m_notify >= 0)
+			{
+				alignas(inotify_event) char buffer[4096];
+				ssize_t length;
+				while ((length = read(m_notify, buffer, sizeof(buffer))) > 0)
+				{
+					for (char* it = buffer; it < buffer + length;)
+					{
+						const inotify_event* event = reinterpret_cast<const inotify_event*>(it);
+						auto dir = m_directories.find(event->wd);
+						if (event->len > 0 && dir != m_directories.end())
+							changed.insert(dir->second + event->name);
+						it += sizeof(inotify_event) + event->len;
+					}
+				}
+				return changed;
+			}
+#endif
+			int64_t time = 0;
+			for (auto& file : m_times)
+				if (SourceLoader::ModificationTime(file.first, time) && time != file.second)
+				{
+					file.second = time;
+					changed.insert(file.first);
+				}
+			return changed;
+		}
+		void ShaderWatcher::releaseShaders(std::vector<Stage>& stages)
+		{
+			for (auto& stage : stages)
+			{
+				DeletionQueue::Release(DeletionQueue::Kind::Shader, stage.shader);
+				stage.shader = 0;
+			}
+		}
+	}
+}
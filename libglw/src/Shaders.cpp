@@ -1,7 +1,9 @@
 #include <libglw/Shaders.h>
+#include <libglw/ShaderWatcher.h>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 //#include <glm/gtc/type_ptr.hpp>
@@ -51,6 +53,26 @@ namespace gl
 			delete[] erreur;
 			err = ostr.str();
 		}
+		std::string shaderInfoLog(GLuint shader)
+		{
+			GLint length(0);
+			glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+			std::string log(length, '\0');
+			if (length > 0)
+				glGetShaderInfoLog(shader, length, &length, &log[0]);
+			log.resize(length);
+			return log;
+		}
+		std::string programInfoLog(GLuint program)
+		{
+			GLint length(0);
+			glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+			std::string log(length, '\0');
+			if (length > 0)
+				glGetProgramInfoLog(program, length, &length, &log[0]);
+			log.resize(length);
+			return log;
+		}
 		CompileException::~CompileException()
 		{
 			if (glIsShader(id))
@@ -70,7 +92,7 @@ namespace gl
 			isRef = false;
 		}
 
-		Program::Program(const Program & program) : Object(program.id())
+		Program::Program(const Program & program) : Object(program.id()), m_reflection(program.m_reflection), m_state(program.m_state)
 		{
 			isRef = true;
 		}
@@ -82,7 +104,8 @@ namespace gl
 
 		Program::~Program()
 		{
-
+			if (m_watcher)
+				m_watcher->unwatch(*this);
 		}
 
 		Program & Program::operator=(Program prog)
@@ -116,16 +139,334 @@ namespace gl
 			return ((*ext)(*this));
 		}
 
+		void Program::detachShader(GLuint shader)
+		{
+			glDetachShader(id(), shader);
+			auto detached = [shader](const StageFile& file) { return file.shader == shader; };
+			m_files.erase(std::remove_if(m_files.begin(), m_files.end(), detached), m_files.end());
+			m_attachedFiles.erase(std::remove_if(m_attachedFiles.begin(), m_attachedFiles.end(), detached), m_attachedFiles.end());
+		}
 		void Program::link()
+		{
+			std::vector<StageFile> attached;
+			attached.swap(m_attachedFiles);
+			submitLink();
+			checkLink();
+			// Stages attached again replace the previous files of their type, the others are still attached
+			for (const auto& file : attached)
+				m_files.erase(std::remove_if(m_files.begin(), m_files.end(), [&file](const StageFile& previous) { return previous.type == file.type; }), m_files.end());
+			m_files.insert(m_files.end(), attached.begin(), attached.end());
+			if (m_files.empty())
+			{
+				if (m_watcher)
+					m_watcher->unwatch(*this);
+				return;
+			}
+			if (ShaderWatcher* watcher = m_watcher ? m_watcher : ShaderWatcher::Current())
+				watcher->watch(*this);
+		}
+		void Program::submitLink()
 		{
 			glGetError();
 			glLinkProgram(id());
+		}
+		bool Program::linkCompleted() const
+		{
+			if (!GLEW_KHR_parallel_shader_compile)
+				return true;
+			GLint completed(GL_FALSE);
+			glGetProgramiv(id(), GL_COMPLETION_STATUS_KHR, &completed);
+			return completed == GL_TRUE;
+		}
+		void Program::checkLink()
+		{
 			GLint link(0);
 			glGetProgramiv(id(), GL_LINK_STATUS, &link);
 			if (link != GL_TRUE)
 				throw LinkException(id());
+			linked();
+		}
+		void Program::setBinaryRetrievable(bool enabled)
+		{
+			if (id() == 0)
+				instantiate();
+			glProgramParameteri(id(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, enabled ? GL_TRUE : GL_FALSE);
+		}
+		std::vector<char> Program::binary(GLenum& format) const
+		{
+			GLint length = 0;
+			glGetProgramiv(id(), GL_PROGRAM_BINARY_LENGTH, &length);
+			std::vector<char> data(length);
+			format = GL_NONE;
+			if (length > 0)
+				glGetProgramBinary(id(), length, &length, &format, data.data());
+			data.resize(length);
+			return data;
+		}
+		bool Program::loadBinary(GLenum format, const void* binary, GLsizei length)
+		{
+			if (isRef)
+				throw std::runtime_error("Program reference not accessible for binary loading");
+			if (id() == 0)
+				instantiate();
+			glProgramBinary(id(), format, binary, length);
+			GLint link(0);
+			glGetProgramiv(id(), GL_LINK_STATUS, &link);
+			if (link != GL_TRUE)
+				return false;
+			linked();
+			return true;
+		}
+		void Program::replace(GLuint program)
+		{
+			if (!isRef)
+			{
+				// References still use the previous name, it's deleted with the last of them
+				if (m_state.use_count() > 1)
+					m_state->retired = id();
+				else
+					DeletionQueue::Release(DeletionQueue::Kind::Program, id());
+			}
+			// References keep the previous cache and shadow, the handles too
+			m_state = std::make_shared<State>();
+			setID(program);
+			linked();
+		}
+		Program::State::~State()
+		{
+			if (retired)
+				DeletionQueue::Release(DeletionQueue::Kind::Program, retired);
 		}
+		void Program::linked()
+		{
+			m_state->locations.clear();
+			m_state->resources.clear();
+			m_state->reflected = false;
+			// Linking resets the uniforms to their default values
+			m_state->shadow->clear();
+			if (m_reflection)
+				reflect();
+		}
+
+		namespace
+		{
+			using Resource = Program::Resource;
 
+			/// Name of the resource, without the "[0]" of arrays
+			std::string resourceName(const char* name)
+			{
+				std::string str(name);
+				if (str.size() > 3 && str.compare(str.size() - 3, 3, "[0]") == 0)
+					str.resize(str.size() - 3);
+				return str;
+			}
+			Resource makeResource(Resource::Kind kind, GLuint index, const char* name)
+			{
+				Resource res;
+				res.kind = kind;
+				res.index = index;
+				res.name = resourceName(name);
+				res.hash = UniformName::Hash(res.name.c_str());
+				return res;
+			}
+			/// Program interface query (OpenGL 4.3)
+			void collectInterface(GLuint program, Resource::Kind kind, GLenum programInterface, std::vector<Resource>& table)
+			{
+				GLint count = 0, maxLength = 0;
+				glGetProgramInterfaceiv(program, programInterface, GL_ACTIVE_RESOURCES, &count);
+				glGetProgramInterfaceiv(program, programInterface, GL_MAX_NAME_LENGTH, &maxLength);
+				std::vector<char> name(maxLength + 1);
+				for (GLint i = 0; i < count; ++i)
+				{
+					glGetProgramResourceName(program, programInterface, i, static_cast<GLsizei>(name.size()), nullptr, name.data());
+					Resource res = makeResource(kind, i, name.data());
+					if (kind == Resource::Kind::Uniform)
+					{
+						const GLenum props[] = { GL_LOCATION, GL_TYPE, GL_ARRAY_SIZE, GL_BLOCK_INDEX, GL_OFFSET };
+						GLint values[5];
+						glGetProgramResourceiv(program, programInterface, i, 5, props, 5, nullptr, values);
+						res.location = values[0];
+						res.type = values[1];
+						res.size = values[2];
+						res.blockIndex = values[3];
+						res.offset = values[3] == -1 ? -1 : values[4];
+					}
+					else if (kind == Resource::Kind::Attribute)
+					{
+						const GLenum props[] = { GL_LOCATION, GL_TYPE, GL_ARRAY_SIZE };
+						GLint values[3];
+						glGetProgramResourceiv(program, programInterface, i, 3, props, 3, nullptr, values);
+						res.location = values[0];
+						res.type = values[1];
+						res.size = values[2];
+					}
+					else
+					{
+						const GLenum props[] = { GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE };
+						GLint values[2];
+						glGetProgramResourceiv(program, programInterface, i, 2, props, 2, nullptr, values);
+						res.binding = values[0];
+						res.size = values[1];
+					}
+					table.push_back(std::move(res));
+				}
+			}
+			/// OpenGL 3.3 queries
+			void collectActive(GLuint program, std::vector<Resource>& table)
+			{
+				GLint count = 0, maxLength = 0;
+				glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+				glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+				std::vector<char> name(maxLength + 1);
+				std::vector<GLuint> indices(count);
+				std::vector<GLint> blocks(count), offsets(count);
+				for (GLint i = 0; i < count; ++i)
+					indices[i] = i;
+				if (count > 0)
+				{
+					glGetActiveUniformsiv(program, count, indices.data(), GL_UNIFORM_BLOCK_INDEX, blocks.data());
+					glGetActiveUniformsiv(program, count, indices.data(), GL_UNIFORM_OFFSET, offsets.data());
+				}
+				for (GLint i = 0; i < count; ++i)
+				{
+					GLint size = 0;
+					GLenum type = GL_NONE;
+					glGetActiveUniform(program, i, static_cast<GLsizei>(name.size()), nullptr, &size, &type, name.data());
+					Resource res = makeResource(Resource::Kind::Uniform, i, name.data());
+					res.type = type;
+					res.size = size;
+					res.blockIndex = blocks[i];
+					if (blocks[i] == -1)
+						res.location = glGetUniformLocation(program, name.data());
+					else
+						res.offset = offsets[i];
+					table.push_back(std::move(res));
+				}
+
+				glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+				glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+				name.resize(maxLength + 1);
+				for (GLint i = 0; i < count; ++i)
+				{
+					glGetActiveUniformBlockName(program, i, static_cast<GLsizei>(name.size()), nullptr, name.data());
+					Resource res = makeResource(Resource::Kind::UniformBlock, i, name.data());
+					glGetActiveUniformBlockiv(program, i, GL_UNIFORM_BLOCK_BINDING, &res.binding);
+					glGetActiveUniformBlockiv(program, i, GL_UNIFORM_BLOCK_DATA_SIZE, &res.size);
+					table.push_back(std::move(res));
+				}
+
+				glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+				glGetProgramiv(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+				name.resize(maxLength + 1);
+				for (GLint i = 0; i < count; ++i)
+				{
+					GLint size = 0;
+					GLenum type = GL_NONE;
+					glGetActiveAttrib(program, i, static_cast<GLsizei>(name.size()), nullptr, &size, &type, name.data());
+					Resource res = makeResource(Resource::Kind::Attribute, i, name.data());
+					res.type = type;
+					res.size = size;
+					res.location = glGetAttribLocation(program, name.data());
+					table.push_back(std::move(res));
+				}
+			}
+			bool lessResource(const Resource& res, std::pair<Resource::Kind, uint32_t> key)
+			{
+				return res.kind != key.first ? res.kind < key.first : res.hash < key.second;
+			}
+			/// Uniform types set with glUniform1i
+			bool isOpaque(GLenum type)
+			{
+				switch (type)
+				{
+				case GL_FLOAT: case GL_FLOAT_VEC2: case GL_FLOAT_VEC3: case GL_FLOAT_VEC4:
+				case GL_INT: case GL_INT_VEC2: case GL_INT_VEC3: case GL_INT_VEC4:
+				case GL_UNSIGNED_INT: case GL_UNSIGNED_INT_VEC2: case GL_UNSIGNED_INT_VEC3: case GL_UNSIGNED_INT_VEC4:
+				case GL_BOOL: case GL_BOOL_VEC2: case GL_BOOL_VEC3: case GL_BOOL_VEC4:
+				case GL_FLOAT_MAT2: case GL_FLOAT_MAT3: case GL_FLOAT_MAT4:
+				case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT2x4: case GL_FLOAT_MAT3x2:
+				case GL_FLOAT_MAT3x4: case GL_FLOAT_MAT4x2: case GL_FLOAT_MAT4x3:
+				case GL_DOUBLE: case GL_DOUBLE_VEC2: case GL_DOUBLE_VEC3: case GL_DOUBLE_VEC4:
+				case GL_DOUBLE_MAT2: case GL_DOUBLE_MAT3: case GL_DOUBLE_MAT4:
+				case GL_DOUBLE_MAT2x3: case GL_DOUBLE_MAT2x4: case GL_DOUBLE_MAT3x2:
+				case GL_DOUBLE_MAT3x4: case GL_DOUBLE_MAT4x2: case GL_DOUBLE_MAT4x3:
+					return false;
+				default:
+					return true;
+				}
+			}
+		}
+		void Program::reflect()
+		{
+			std::vector<Resource> table;
+			if (GLEW_VERSION_4_3 || GLEW_ARB_program_interface_query)
+			{
+				collectInterface(id(), Resource::Kind::Uniform, GL_UNIFORM, table);
+				collectInterface(id(), Resource::Kind::UniformBlock, GL_UNIFORM_BLOCK, table);
+				collectInterface(id(), Resource::Kind::Attribute, GL_PROGRAM_INPUT, table);
+				// The interface query extension can come without storage blocks
+				if (GLEW_VERSION_4_3 || GLEW_ARB_shader_storage_buffer_object)
+					collectInterface(id(), Resource::Kind::StorageBlock, GL_SHADER_STORAGE_BLOCK, table);
+			}
+			else
+				collectActive(id(), table);
+			std::sort(table.begin(), table.end(), [](const Resource& a, const Resource& b) {
+				return a.kind != b.kind ? a.kind < b.kind : a.hash < b.hash;
+			});
+			m_state->resources.swap(table);
+			m_state->reflected = true;
+		}
+		bool Program::reflected() const
+		{
+			return m_state->reflected;
+		}
+		const std::vector<Program::Resource>& Program::resources() const
+		{
+			return m_state->resources;
+		}
+		const Program::Resource* Program::resource(Resource::Kind kind, UniformName name) const
+		{
+			const auto& table = m_state->resources;
+			auto key = std::make_pair(kind, name.hash());
+			for (auto it = std::lower_bound(table.begin(), table.end(), key, lessResource); it != table.end() && it->kind == kind && it->hash == name.hash(); ++it)
+				if (it->name == name.c_str())
+					return &*it;
+			return nullptr;
+		}
+		void Program::checkUniformType(UniformName name, GLenum expected) const
+		{
+			const Resource* res = resource(Resource::Kind::Uniform, name);
+			if (!res)
+				return;
+			bool matches = res->type == expected;
+			// Samplers and images are set as int, booleans as int or uint
+			if (expected == GL_INT)
+				matches = matches || res->type == GL_BOOL || isOpaque(res->type);
+			else if (expected == GL_UNSIGNED_INT)
+				matches = matches || res->type == GL_BOOL;
+			if (!matches)
+				throw std::runtime_error(std::string("gl::sl::Program uniform type mismatch (") + name.c_str() + ")");
+		}
+		void Program::bindUniformBlock(UniformName block, GLuint binding)
+		{
+			const Resource* res = resource(Resource::Kind::UniformBlock, block);
+			GLuint index = res ? res->index : glGetUniformBlockIndex(id(), block.c_str());
+			if (index == GL_INVALID_INDEX)
+				return;
+			glUniformBlockBinding(id(), index, binding);
+			if (res)
+				m_state->resources[res - m_state->resources.data()].binding = binding;
+		}
+		void Program::bindStorageBlock(UniformName block, GLuint binding)
+		{
+			const Resource* res = resource(Resource::Kind::StorageBlock, block);
+			GLuint index = res ? res->index : glGetProgramResourceIndex(id(), GL_SHADER_STORAGE_BLOCK, block.c_str());
+			if (index == GL_INVALID_INDEX)
+				return;
+			glShaderStorageBlockBinding(id(), index, binding);
+			if (res)
+				m_state->resources[res - m_state->resources.data()].binding = binding;
+		}
 		GLint Program::getAttribLocation(const std::string & name) const
 		{
 			return getAttribLocation(name.c_str());
@@ -151,16 +492,33 @@ namespace gl
 
 		GLint Program::getUniformLocation(const std::string& name) const
 		{
-			return getUniformLocation(name.c_str());
+			return getUniformLocation(UniformName(name));
 		}
 
 		GLint Program::getUniformLocation(const char * name) const
 		{
-			return glGetUniformLocation(id(), name);
+			return getUniformLocation(UniformName(name));
+		}
+
+		GLint Program::getUniformLocation(UniformName name) const
+		{
+			if (const Resource* res = resource(Resource::Kind::Uniform, name))
+				return res->location;
+			auto& locations = m_state->locations;
+			auto it = locations.find(name.hash());
+			if (it == locations.end())
+			{
+				GLint location = glGetUniformLocation(id(), name.c_str());
+				locations.emplace(name.hash(), std::make_pair(std::string(name.c_str()), location));
+				return location;
+			}
+			if (it->second.first != name.c_str())
+				return glGetUniformLocation(id(), name.c_str()); // hash collision, not cached
+			return it->second.second;
 		}
 		void Program::use()  const
 		{
-			glUseProgram(id());
+			StateCache::Current().useProgram(id());
 		}
 		void Program::load(const std::string& name)
 		{
@@ -180,21 +538,145 @@ namespace gl
 			using std::swap;
 			Object::swap(prog);
 			swap(prog.isRef, isRef);
+			swap(prog.m_reflection, m_reflection);
+			swap(prog.m_state, m_state);
+			swap(prog.m_files, m_files);
+			swap(prog.m_attachedFiles, m_attachedFiles);
+			swap(prog.m_watcher, m_watcher);
+			// The watchers know the programs by address
+			if (m_watcher)
+				m_watcher->swapped(*this, prog);
+			if (prog.m_watcher && prog.m_watcher != m_watcher)
+				prog.m_watcher->swapped(*this, prog);
 		}
 		void Program::instantiate()
 		{
 			GLuint myid = id();
-			if (!exists())
+			if (myid == 0)
 				myid = glCreateProgram();
 			setID(myid);
 		}
 		void Program::destroy()
 		{
+			if (m_watcher)
+				m_watcher->unwatch(*this);
+			m_files.clear();
+			m_attachedFiles.clear();
 			GLuint myid = id();
-			if (!isRef && exists())
-				glDeleteProgram(myid);
+			if (!isRef)
+				DeletionQueue::Release(DeletionQueue::Kind::Program, myid);
 			setID(0);
 			isRef = false;
+			// References keep the previous cache
+			m_state = std::make_shared<State>();
+		}
+		void Program::setSeparable(bool enabled)
+		{
+			if (id() == 0)
+				instantiate();
+			glProgramParameteri(id(), GL_PROGRAM_SEPARABLE, enabled ? GL_TRUE : GL_FALSE);
+		}
+
+		GLbitfield stageBit(TypeShader type)
+		{
+			switch (type)
+			{
+			case Vertex: return GL_VERTEX_SHADER_BIT;
+			case Fragment: return GL_FRAGMENT_SHADER_BIT;
+			case Geometry: return GL_GEOMETRY_SHADER_BIT;
+			case Compute: return GL_COMPUTE_SHADER_BIT;
+			}
+			throw std::runtime_error("gl::sl::stageBit invalid shader type");
+		}
+		const std::array<GLbitfield, ProgramPipeline::Stages> ProgramPipeline::StageBits = {
+			GL_VERTEX_SHADER_BIT, GL_TESS_CONTROL_SHADER_BIT, GL_TESS_EVALUATION_SHADER_BIT,
+			GL_GEOMETRY_SHADER_BIT, GL_FRAGMENT_SHADER_BIT, GL_COMPUTE_SHADER_BIT
+		};
+		ProgramPipeline::ProgramPipeline() : Object()
+		{
+			if (Object::GetAutoInstantiate())
+				instantiate();
+		}
+		ProgramPipeline::~ProgramPipeline()
+		{
+			destroy();
+		}
+		void ProgramPipeline::useStages(const Program& program, GLbitfield stages)
+		{
+			if (program.id() == 0)
+				throw std::runtime_error("gl::sl::ProgramPipeline::useStages program not linked");
+			if (id() == 0)
+				instantiate();
+			// Only the stages using another program
+			GLbitfield changed = 0;
+			for (int i = 0; i < Stages; ++i)
+				if ((stages & StageBits[i]) && m_stages[i] != program.id())
+				{
+					changed |= StageBits[i];
+					m_stages[i] = program.id();
+				}
+			if (changed)
+				glUseProgramStages(id(), changed, program.id());
+		}
+		void ProgramPipeline::clearStages(GLbitfield stages)
+		{
+			GLbitfield changed = 0;
+			for (int i = 0; i < Stages; ++i)
+				if ((stages & StageBits[i]) && m_stages[i] != 0)
+				{
+					changed |= StageBits[i];
+					m_stages[i] = 0;
+				}
+			if (changed)
+				glUseProgramStages(id(), changed, 0);
+		}
+		GLuint ProgramPipeline::stageProgram(TypeShader type) const
+		{
+			const GLbitfield bit = stageBit(type);
+			for (int i = 0; i < Stages; ++i)
+				if (StageBits[i] == bit)
+					return m_stages[i];
+			return 0;
+		}
+		void ProgramPipeline::setActiveProgram(const Program& program)
+		{
+			glActiveShaderProgram(id(), program.id());
+		}
+		bool ProgramPipeline::validate(std::string* log) const
+		{
+			glValidateProgramPipeline(id());
+			GLint status(0);
+			glGetProgramPipelineiv(id(), GL_VALIDATE_STATUS, &status);
+			if (log)
+			{
+				GLint length(0);
+				glGetProgramPipelineiv(id(), GL_INFO_LOG_LENGTH, &length);
+				log->assign(length > 0 ? length : 0, '\0');
+				if (length > 0)
+				{
+					glGetProgramPipelineInfoLog(id(), length, &length, &(*log)[0]);
+					log->resize(length);
+				}
+			}
+			return status == GL_TRUE;
+		}
+		void ProgramPipeline::bind() const
+		{
+			StateCache::Current().useProgram(0);
+			StateCache::Current().bindProgramPipeline(id());
+		}
+		void ProgramPipeline::instantiate()
+		{
+			GLuint myID = id();
+			if (myID == 0)
+				myID = NamePools::Current().programPipelines.acquire();
+			setID(myID);
+		}
+		void ProgramPipeline::destroy()
+		{
+			DeletionQueue::Release(DeletionQueue::Kind::ProgramPipeline, id());
+			setID(0);
+			m_stages.fill(0);
 		}
 
 
@@ -0,0 +1,202 @@
+#include <libglw/SourceLoader.h>
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#if !LIBGLW_WITH_STD_FILESYSTEM
+#	include <sys/stat.h>
+#endif
+namespace gl
+{
+	namespace sl
+	{
+		namespace
+		{
+			bool exists(const std::string& path)
+			{
+				int64_t time;
+				return SourceLoader::ModificationTime(path, time);
+			}
+			/// Directory of a normalized path, with its final '/'
+			std::string directory(const std::string& path)
+			{
+				size_t slash = path.rfind('/');
+				return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+			}
+			/// If the line is the directive *name*, return the position after it
+			size_t directive(const char* first, const char* last, const char* name)
+			{
+				const char* it = first;
+				while (it != last && (*it == ' ' || *it == '\t'))
+					++it;
+				if (it == last || *it != '#')
+					return 0;
+				++it;
+				while (it != last && (*it == ' ' || *it == '\t'))
+					++it;
+				const size_t length = std::char_traits<char>::length(name);
+				if (static_cast<size_t>(last - it) < length || std::char_traits<char>::compare(it, name, length) != 0)
+					return 0;
+				return it + length - first;
+			}
+			/// File name of an #include line, between quotes or angle brackets
+			bool includeName(const char* first, const char* last, std::string& name)
+			{
+				const char* open = std::find_if(first, last, [](char c) { return c == '"' || c == '<'; });
+				if (open == last)
+					return false;
+				const char* close = std::find(open + 1, last, *open == '"' ? '"' : '>');
+				if (close == last)
+					return false;
+				name.assign(open + 1, close);
+				return true;
+			}
+		}
+		SourceLoader& SourceLoader::Global()
+		{
+			static SourceLoader loader;
+			return loader;
+		}
+		bool SourceLoader::ModificationTime(const std::string& path, int64_t& time)
+		{
+#if LIBGLW_WITH_STD_FILESYSTEM
+			std::error_code error;
+			auto fileTime = std::filesystem::last_write_time(path, error);
+			if (error)
+				return false;
+			time = static_cast<int64_t>(fileTime.time_since_epoch().count());
+#else
+			struct stat info;
+			if (stat(path.c_str(), &info) != 0)
+				return false;
+			time = static_cast<int64_t>(info.st_mtime);
+#endif
+			return true;
+		}
+		std::string SourceLoader::Normalize(const std::string& path)
+		{
+#if LIBGLW_WITH_STD_FILESYSTEM
+			return std::filesystem::path(path).lexically_normal().generic_string();
+#else
+			std::string result(path);
+			std::replace(result.begin(), result.end(), '\\', '/');
+			return result;
+#endif
+		}
+		const std::string& SourceLoader::load(const std::string& path)
+		{
+			const std::string key = Normalize(path);
+			auto it = m_sources.find(key);
+			if (it != m_sources.end() && upToDate(it->second))
+			{
+				++m_stats.hits;
+				return it->second.code;
+			}
+			Source source;
+			source.files.push_back(key);
+			expand(source, 0);
+			Source& cached = m_sources[key];
+			cached = std::move(source);
+			return cached.code;
+		}
+		const std::vector<std::string>& SourceLoader::files(const std::string& path) const
+		{
+			auto it = m_sources.find(Normalize(path));
+			if (it == m_sources.end())
+				throw std::runtime_error("gl::sl::SourceLoader source not loaded (" + path + ")");
+			return it->second.files;
+		}
+		void SourceLoader::addIncludePath(std::string directory)
+		{
+			directory = Normalize(directory);
+			if (!directory.empty() && directory.back() != '/')
+				directory += '/';
+			m_includePaths.push_back(std::move(directory));
+		}
+		void SourceLoader::clear()
+		{
+			m_files.clear();
+			m_sources.clear();
+		}
+		const SourceLoader::File& SourceLoader::file(const std::string& path)
+		{
+			int64_t time = 0;
+			if (!ModificationTime(path, time))
+				throw std::runtime_error("gl::sl::SourceLoader file not found (" + path + ")");
+			File& file = m_files[path];
+			if (file.read && file.time == time)
+				return file;
+			// One read for the whole file
+			std::ifstream stream(path, std::ios::binary | std::ios::ate);
+			if (!stream)
+				throw std::runtime_error("gl::sl::SourceLoader file not found (" + path + ")");
+			const std::streamoff size = stream.tellg();
+			file.content.resize(static_cast<size_t>(size));
+			stream.seekg(0);
+			if (size > 0 && !stream.read(&file.content[0], size))
+				throw std::runtime_error("gl::sl::SourceLoader can't read (" + path + ")");
+			file.time = time;
+			file.read = true;
+			++m_stats.reads;
+			return file;
+		}
+		void SourceLoader::expand(Source& source, size_t index)
+		{
+			const std::string path = source.files[index];
+			const File& content = file(path);
+			source.times.push_back(content.time);
+			const char* data = content.content.data();
+			const char* end = data + content.content.size();
+			size_t lineNumber = 1;
+			std::string name;
+			for (const char* line = data; line < end; ++lineNumber)
+			{
+				const char* lineEnd = std::find(line, end, '\n');
+				const char* next = lineEnd == end ? end : lineEnd + 1;
+				if (size_t after = directive(line, lineEnd, "include"))
+				{
+					if (!includeName(line + after, lineEnd, name))
+						throw std::runtime_error("gl::sl::SourceLoader invalid #include (" + path + ":" + std::to_string(lineNumber) + ")");
+					const std::string included = resolve(name, path);
+					// Included once per source, like a header with guards
+					if (std::find(source.files.begin(), source.files.end(), included) == source.files.end())
+					{
+						source.files.push_back(included);
+						source.code += "#line 1 " + std::to_string(source.files.size() - 1) + '\n';
+						expand(source, source.files.size() - 1);
+						if (!source.code.empty() && source.code.back() != '\n')
+							source.code += '\n';
+						source.code += "#line " + std::to_string(lineNumber + 1) + ' ' + std::to_string(index) + '\n';
+					}
+					else
+						source.code += '\n';
+				}
+				else if (directive(line, lineEnd, "pragma once"))
+					source.code += '\n';
+				else
+					source.code.append(line, next);
+				line = next;
+			}
+		}
+		std::string SourceLoader::resolve(const std::string& name, const std::string& includer) const
+		{
+			std::string path = Normalize(directory(includer) + name);
+			if (exists(path))
+				return path;
+			for (const auto& includePath : m_includePaths)
+			{
+				path = Normalize(includePath + name);
+				if (exists(path))
+					return path;
+			}
+			throw std::runtime_error("gl::sl::SourceLoader include not found (" + name + " in " + includer + ")");
+		}
+		bool SourceLoader::upToDate(const Source& source) const
+		{
+			int64_t time = 0;
+			for (size_t i = 0; i < source.files.size(); ++i)
+				if (!ModificationTime(source.files[i], time) || time != source.times[i])
+					return false;
+			return true;
+		}
+	}
+}
@@ -0,0 +1,358 @@
+#include <libglw/StateCache.h>
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#if LIBGLW_WITH_STATE_CHECK
+#	define LIBGLW_ASSERT_STATE() assert(check() && "gl::StateCache out of sync with the driver")
+#else
+#	define LIBGLW_ASSERT_STATE()
+#endif
+namespace gl
+{
+	namespace
+	{
+		thread_local StateCache t_defaultCache;
+		thread_local StateCache* t_currentCache = nullptr;
+
+		/// Binding queries, in bufferSlot order
+		constexpr GLenum BufferBindings[] = {
+			GL_ARRAY_BUFFER_BINDING, GL_ELEMENT_ARRAY_BUFFER_BINDING, GL_COPY_READ_BUFFER_BINDING, GL_COPY_WRITE_BUFFER_BINDING,
+			GL_PIXEL_PACK_BUFFER_BINDING, GL_PIXEL_UNPACK_BUFFER_BINDING, GL_TEXTURE_BUFFER_BINDING, GL_UNIFORM_BUFFER_BINDING,
+			GL_TRANSFORM_FEEDBACK_BUFFER_BINDING, GL_DRAW_INDIRECT_BUFFER_BINDING, GL_DISPATCH_INDIRECT_BUFFER_BINDING,
+			GL_SHADER_STORAGE_BUFFER_BINDING, GL_ATOMIC_COUNTER_BUFFER_BINDING, GL_QUERY_BUFFER_BINDING
+		};
+		/// First buffer slot newer than OpenGL 3.3
+		constexpr int BufferSlotsCore = 9;
+		/// Binding queries, in textureSlot order
+		constexpr GLenum TextureBindings[] = {
+			GL_TEXTURE_BINDING_1D, GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_3D, GL_TEXTURE_BINDING_1D_ARRAY,
+			GL_TEXTURE_BINDING_2D_ARRAY, GL_TEXTURE_BINDING_RECTANGLE, GL_TEXTURE_BINDING_CUBE_MAP, GL_TEXTURE_BINDING_CUBE_MAP_ARRAY,
+			GL_TEXTURE_BINDING_BUFFER, GL_TEXTURE_BINDING_2D_MULTISAMPLE, GL_TEXTURE_BINDING_2D_MULTISAMPLE_ARRAY
+		};
+		/// Slot of GL_TEXTURE_CUBE_MAP_ARRAY, newer than OpenGL 3.3
+		constexpr int TextureSlotCubeArray = 7;
+		/// Pixel store parameters, in pixelStoreSlot order, and their initial values
+		constexpr GLenum PixelStoreQueries[] = { GL_PACK_ALIGNMENT, GL_UNPACK_ALIGNMENT, GL_PACK_ROW_LENGTH, GL_UNPACK_ROW_LENGTH };
+		constexpr GLuint PixelStoreDefaults[] = { 4, 4, 0, 0 };
+
+		/// True if the binding is unknown or matches the driver
+		bool matches(GLenum query, GLuint cached)
+		{
+			if (cached == StateCache::Unknown)
+				return true;
+			GLint bound = 0;
+			glGetIntegerv(query, &bound);
+			return static_cast<GLuint>(bound) == cached;
+		}
+	}
+	StateCache::StateCache()
+	{
+		m_default = 0;
+		m_buffers.fill(0);
+		m_vertexArray = 0;
+		m_program = 0;
+		m_pipeline = 0;
+		m_activeUnit = 0;
+		m_readFramebuffer = m_drawFramebuffer = 0;
+		m_renderbuffer = 0;
+		std::copy(std::begin(PixelStoreDefaults), std::end(PixelStoreDefaults), m_pixelStore.begin());
+	}
+	StateCache& StateCache::Current()
+	{
+		return t_currentCache ? *t_currentCache : t_defaultCache;
+	}
+	void StateCache::MakeCurrent(StateCache* cache)
+	{
+		t_currentCache = cache;
+	}
+	void StateCache::invalidate()
+	{
+		m_default = Unknown;
+		m_buffers.fill(Unknown);
+		m_vertexArray = Unknown;
+		m_program = Unknown;
+		m_pipeline = Unknown;
+		m_activeUnit = Unknown;
+		m_textures.clear();
+		m_samplers.clear();
+		m_readFramebuffer = m_drawFramebuffer = Unknown;
+		m_renderbuffer = Unknown;
+		m_pixelStore.fill(Unknown);
+	}
+	bool StateCache::check() const
+	{
+		bool ok = true;
+		for (int slot = 0; slot < static_cast<int>(BufferTargets); ++slot)
+		{
+			// Targets of newer versions may not exist : only check them once something has been bound
+			if (slot >= BufferSlotsCore && m_buffers[slot] == 0)
+				continue;
+			ok = ok && matches(BufferBindings[slot], m_buffers[slot]);
+		}
+		ok = ok && matches(GL_VERTEX_ARRAY_BINDING, m_vertexArray);
+		ok = ok && matches(GL_CURRENT_PROGRAM, m_program);
+		// Pipelines need OpenGL 4.1 : only check once one has been bound
+		if (m_pipeline != 0)
+			ok = ok && matches(GL_PROGRAM_PIPELINE_BINDING, m_pipeline);
+		ok = ok && matches(GL_READ_FRAMEBUFFER_BINDING, m_readFramebuffer);
+		ok = ok && matches(GL_DRAW_FRAMEBUFFER_BINDING, m_drawFramebuffer);
+		ok = ok && matches(GL_RENDERBUFFER_BINDING, m_renderbuffer);
+		for (int slot = 0; slot < static_cast<int>(PixelStoreParameters); ++slot)
+			ok = ok && matches(PixelStoreQueries[slot], m_pixelStore[slot]);
+		if (m_activeUnit == Unknown)
+			return ok;
+		ok = ok && matches(GL_ACTIVE_TEXTURE, GL_TEXTURE0 + m_activeUnit);
+		if (m_activeUnit < m_textures.size())
+			for (int slot = 0; slot < static_cast<int>(TextureTargets); ++slot)
+			{
+				if (slot == TextureSlotCubeArray && m_textures[m_activeUnit][slot] == 0)
+					continue;
+				ok = ok && matches(TextureBindings[slot], m_textures[m_activeUnit][slot]);
+			}
+		if (m_activeUnit < m_samplers.size())
+			ok = ok && matches(GL_SAMPLER_BINDING, m_samplers[m_activeUnit]);
+		return ok;
+	}
+	int StateCache::bufferSlot(GLenum target)
+	{
+		switch (target)
+		{
+		case GL_ARRAY_BUFFER: return 0;
+		case GL_ELEMENT_ARRAY_BUFFER: return 1;
+		case GL_COPY_READ_BUFFER: return 2;
+		case GL_COPY_WRITE_BUFFER: return 3;
+		case GL_PIXEL_PACK_BUFFER: return 4;
+		case GL_PIXEL_UNPACK_BUFFER: return 5;
+		case GL_TEXTURE_BUFFER: return 6;
+		case GL_UNIFORM_BUFFER: return 7;
+		case GL_TRANSFORM_FEEDBACK_BUFFER: return 8;
+		case GL_DRAW_INDIRECT_BUFFER: return 9;
+		case GL_DISPATCH_INDIRECT_BUFFER: return 10;
+		case GL_SHADER_STORAGE_BUFFER: return 11;
+		case GL_ATOMIC_COUNTER_BUFFER: return 12;
+		case GL_QUERY_BUFFER: return 13;
+		default: return -1;
+		}
+	}
+	int StateCache::textureSlot(GLenum target)
+	{
+		switch (target)
+		{
+		case GL_TEXTURE_1D: return 0;
+		case GL_TEXTURE_2D: return 1;
+		case GL_TEXTURE_3D: return 2;
+		case GL_TEXTURE_1D_ARRAY: return 3;
+		case GL_TEXTURE_2D_ARRAY: return 4;
+		case GL_TEXTURE_RECTANGLE: return 5;
+		case GL_TEXTURE_CUBE_MAP: return 6;
+		case GL_TEXTURE_CUBE_MAP_ARRAY: return 7;
+		case GL_TEXTURE_BUFFER: return 8;
+		case GL_TEXTURE_2D_MULTISAMPLE: return 9;
+		case GL_TEXTURE_2D_MULTISAMPLE_ARRAY: return 10;
+		default: return -1;
+		}
+	}
+	int StateCache::pixelStoreSlot(GLenum parameter)
+	{
+		switch (parameter)
+		{
+		case GL_PACK_ALIGNMENT: return 0;
+		case GL_UNPACK_ALIGNMENT: return 1;
+		case GL_PACK_ROW_LENGTH: return 2;
+		case GL_UNPACK_ROW_LENGTH: return 3;
+		default: return -1;
+		}
+	}
+	StateCache::TextureUnit& StateCache::unit(GLuint index)
+	{
+		if (index >= m_textures.size())
+		{
+			TextureUnit fresh;
+			fresh.fill(m_default);
+			m_textures.resize(index + 1, fresh);
+		}
+		return m_textures[index];
+	}
+	bool StateCache::update(GLuint& cached, GLuint id)
+	{
+		if (cached == id)
+		{
+			++m_stats.skipped;
+			return false;
+		}
+		cached = id;
+		++m_stats.issued;
+		return true;
+	}
+	void StateCache::bindBuffer(GLenum target, GLuint id)
+	{
+		int slot = bufferSlot(target);
+		if (slot < 0)
+		{
+			++m_stats.issued;
+			glBindBuffer(target, id);
+		}
+		else if (update(m_buffers[slot], id))
+			glBindBuffer(target, id);
+		LIBGLW_ASSERT_STATE();
+	}
+	void StateCache::bufferBound(GLenum target, GLuint id)
+	{
+		int slot = bufferSlot(target);
+		if (slot >= 0)
+			m_buffers[slot] = id;
+	}
+	void StateCache::bindVertexArray(GLuint id)
+	{
+		if (update(m_vertexArray, id))
+		{
+			glBindVertexArray(id);
+			// The element buffer binding belongs to the VAO
+			m_buffers[bufferSlot(GL_ELEMENT_ARRAY_BUFFER)] = Unknown;
+		}
+		LIBGLW_ASSERT_STATE();
+	}
+	void StateCache::useProgram(GLuint id)
+	{
+		if (update(m_program, id))
+			glUseProgram(id);
+		LIBGLW_ASSERT_STATE();
+	}
+	void StateCache::bindProgramPipeline(GLuint id)
+	{
+		if (update(m_pipeline, id))
+			glBindProgramPipeline(id);
+		LIBGLW_ASSERT_STATE();
+	}
+	void StateCache::activeTexture(GLuint unit)
+	{
+		if (update(m_activeUnit, unit))
+			glActiveTexture(GL_TEXTURE0 + unit);
+		LIBGLW_ASSERT_STATE();
+	}
+	void StateCache::bindTexture(GLuint unitIndex, GLenum target, GLuint id)
+	{
+		int slot = textureSlot(target);
+		if (slot < 0)
+		{
+			activeTexture(unitIndex);
+			++m_stats.issued;
+			glBindTexture(target, id);
+		}
+		else if (unit(unitIndex)[slot] == id)
+			++m_stats.skipped;
+		else
+		{
+			// Activate first : the cache must match the driver at each step
+			activeTexture(unitIndex);
+			update(m_textures[unitIndex][slot], id);
+			glBindTexture(target, id);
+		}
+		LIBGLW_ASSERT_STATE();
+	}
+	void StateCache::bindTexture(GLenum target, GLuint id)
+	{
+		if (m_activeUnit == Unknown)
+		{
+			// Can't know which unit is touched : forget every unit
+			++m_stats.issued;
+			glBindTexture(target, id);
+			m_textures.clear();
+			return;
+		}
+		bindTexture(m_activeUnit, target, id);
+	}
+	void StateCache::bindSampler(GLuint unit, GLuint id)
+	{
+		if (unit >= m_samplers.size())
+			m_samplers.resize(unit + 1, m_default);
+		if (update(m_samplers[unit], id))
+			glBindSampler(unit, id);
+		LIBGLW_ASSERT_STATE();
+	}
+	void StateCache::bindFramebuffer(GLenum target, GLuint id)
+	{
+		switch (target)
+		{
+		case GL_READ_FRAMEBUFFER:
+			if (update(m_readFramebuffer, id))
+				glBindFramebuffer(target, id);
+			break;
+		case GL_DRAW_FRAMEBUFFER:
+			if (update(m_drawFramebuffer, id))
+				glBindFramebuffer(target, id);
+			break;
+		default:
+			if (m_readFramebuffer == id && m_drawFramebuffer == id)
+			{
+				++m_stats.skipped;
+				break;
+			}
+			m_readFramebuffer = m_drawFramebuffer = id;
+			++m_stats.issued;
+			glBindFramebuffer(target, id);
+			break;
+		}
+		LIBGLW_ASSERT_STATE();
+	}
+	void StateCache::bindRenderbuffer(GLuint id)
+	{
+		if (update(m_renderbuffer, id))
+			glBindRenderbuffer(GL_RENDERBUFFER, id);
+		LIBGLW_ASSERT_STATE();
+	}
+	void StateCache::pixelStore(GLenum parameter, GLint value)
+	{
+		int slot = pixelStoreSlot(parameter);
+		if (slot < 0)
+		{
+			++m_stats.issued;
+			glPixelStorei(parameter, value);
+		}
+		else if (update(m_pixelStore[slot], static_cast<GLuint>(value)))
+			glPixelStorei(parameter, value);
+		LIBGLW_ASSERT_STATE();
+	}
+	void StateCache::deletedBuffer(GLuint id)
+	{
+		for (auto& bound : m_buffers)
+			if (bound == id)
+				bound = 0;
+	}
+	void StateCache::deletedVertexArray(GLuint id)
+	{
+		if (m_vertexArray == id)
+		{
+			m_vertexArray = 0;
+			m_buffers[bufferSlot(GL_ELEMENT_ARRAY_BUFFER)] = Unknown;
+		}
+	}
+	void StateCache::deletedTexture(GLuint id)
+	{
+		for (auto& textures : m_textures)
+			for (auto& bound : textures)
+				if (bound == id)
+					bound = 0;
+	}
+	void StateCache::deletedSampler(GLuint id)
+	{
+		std::replace(m_samplers.begin(), m_samplers.end(), id, 0u);
+	}
+	void StateCache::deletedFramebuffer(GLuint id)
+	{
+		if (m_readFramebuffer == id)
+			m_readFramebuffer = 0;
+		if (m_drawFramebuffer == id)
+			m_drawFramebuffer = 0;
+	}
+	void StateCache::deletedRenderbuffer(GLuint id)
+	{
+		if (m_renderbuffer == id)
+			m_renderbuffer = 0;
+	}
+	void StateCache::deletedProgramPipeline(GLuint id)
+	{
+		if (m_pipeline == id)
+			m_pipeline = 0;
+	}
+}
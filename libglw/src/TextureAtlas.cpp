@@ -0,0 +1,208 @@
+#include <libglw/TextureAtlas.h>
+#include <algorithm>
+#include <limits>
+namespace gl
+{
+	TextureAtlas::TextureAtlas(glm::ivec2 size, GLenum internalFormat, GLint padding, GLsizei levels) : m_size(size), m_padding(padding)
+	{
+		if (size.x <= 0 || size.y <= 0 || padding < 0 || levels <= 0)
+			throw std::runtime_error("gl::TextureAtlas invalid parameters");
+		m_texture.setTarget(GL_TEXTURE_2D);
+		m_texture.allocate(levels, internalFormat, size);
+		m_cell = 1 << (m_texture.getLevels() - 1);
+		clear();
+	}
+	TextureAtlas::Handle TextureAtlas::insert(glm::ivec2 size, GLenum format, GLenum type, const void* pixels)
+	{
+		if (size.x <= 0 || size.y <= 0)
+			throw std::runtime_error("gl::TextureAtlas::insert invalid size");
+		// Cells needed by the image and its padding
+		const int w = (size.x + 2 * m_padding + m_cell - 1) / m_cell;
+		const int h = (size.y + 2 * m_padding + m_cell - 1) / m_cell;
+		Rect rect;
+		if (!place(w, h, rect))
+			return Invalid;
+		split(rect);
+		prune();
+
+		Handle handle;
+		if (!m_freeSlots.empty())
+		{
+			handle = m_freeSlots.back();
+			m_freeSlots.pop_back();
+		}
+		else
+		{
+			handle = static_cast<Handle>(m_slots.size());
+			m_slots.emplace_back();
+		}
+		Slot& slot = m_slots[handle];
+		slot.rect = rect;
+		slot.used = true;
+		slot.entry.position = glm::ivec2(rect.x * m_cell + m_padding, rect.y * m_cell + m_padding);
+		slot.entry.size = size;
+		slot.entry.uv = glm::vec4(
+			static_cast<float>(slot.entry.position.x) / m_size.x, static_cast<float>(slot.entry.position.y) / m_size.y,
+			static_cast<float>(slot.entry.position.x + size.x) / m_size.x, static_cast<float>(slot.entry.position.y + size.y) / m_size.y);
+		++m_count;
+		m_usedCells += static_cast<int64_t>(w) * h;
+		if (pixels)
+			update(handle, format, type, pixels);
+		return handle;
+	}
+	void TextureAtlas::update(Handle handle, GLenum format, GLenum type, const void* pixels)
+	{
+		const Slot& updated = slot(handle);
+		const Entry& entry = updated.entry;
+		if (!pixels)
+			throw std::runtime_error("gl::TextureAtlas::update without pixels");
+		const GLsizeiptr pixel = pixelSize(format, type);
+		// The whole region is written : the cells rounding leaves more than the padding around the image
+		const glm::ivec2 origin(updated.rect.x * m_cell, updated.rect.y * m_cell);
+		const glm::ivec2 region(updated.rect.w * m_cell, updated.rect.h * m_cell);
+		const glm::ivec2 offset = entry.position - origin;
+		// Rows of the upload are 4 bytes aligned, GL_UNPACK_ALIGNMENT is set for it below
+		const GLsizeiptr pitch = rowPitch(format, type, region.x);
+		const GLsizeiptr sourcePitch = pixel * entry.size.x;
+		const unsigned char* source = static_cast<const unsigned char*>(pixels);
+		std::vector<unsigned char> image(pitch * region.y);
+		for (int y = 0; y < region.y; ++y)
+		{
+			// The border repeats the edge pixels
+			const int sourceY = glm::clamp(y - offset.y, 0, entry.size.y - 1);
+			const unsigned char* sourceRow = source + sourceY * sourcePitch;
+			unsigned char* row = image.data() + y * pitch;
+			for (int x = 0; x < offset.x; ++x)
+				std::memcpy(row + x * pixel, sourceRow, pixel);
+			std::memcpy(row + offset.x * pixel, sourceRow, sourcePitch);
+			for (int x = offset.x + entry.size.x; x < region.x; ++x)
+				std::memcpy(row + x * pixel, sourceRow + sourcePitch - pixel, pixel);
+		}
+		// Glyph atlases often run with an alignment of 1, set by the application
+		StateCache::Current().pixelStore(GL_UNPACK_ALIGNMENT, 4);
+		StateCache::Current().pixelStore(GL_UNPACK_ROW_LENGTH, 0);
+		m_texture.update(0, origin, region, format, type, image.data());
+	}
+	void TextureAtlas::remove(Handle handle)
+	{
+		const Slot& removed = slot(handle);
+		const Rect rect = removed.rect;
+		m_slots[handle].used = false;
+		m_freeSlots.push_back(handle);
+		--m_count;
+		m_usedCells -= static_cast<int64_t>(rect.w) * rect.h;
+		release(rect);
+	}
+	void TextureAtlas::clear()
+	{
+		m_free.clear();
+		m_free.push_back({0, 0, m_size.x / m_cell, m_size.y / m_cell});
+		m_slots.clear();
+		m_freeSlots.clear();
+		m_count = 0;
+		m_usedCells = 0;
+	}
+	const TextureAtlas::Entry& TextureAtlas::entry(Handle handle) const
+	{
+		return slot(handle).entry;
+	}
+	float TextureAtlas::occupancy() const
+	{
+		return static_cast<float>(m_usedCells * m_cell * m_cell) / (static_cast<float>(m_size.x) * m_size.y);
+	}
+	bool TextureAtlas::place(int w, int h, Rect& result) const
+	{
+		int bestShort = std::numeric_limits<int>::max();
+		int bestLong = std::numeric_limits<int>::max();
+		for (const auto& free : m_free)
+		{
+			if (free.w < w || free.h < h)
+				continue;
+			const int leftoverX = free.w - w, leftoverY = free.h - h;
+			const int shortSide = std::min(leftoverX, leftoverY), longSide = std::max(leftoverX, leftoverY);
+			if (shortSide < bestShort || (shortSide == bestShort && longSide < bestLong))
+			{
+				result = {free.x, free.y, w, h};
+				bestShort = shortSide;
+				bestLong = longSide;
+			}
+		}
+		return bestShort != std::numeric_limits<int>::max();
+	}
+	void TextureAtlas::split(const Rect& used)
+	{
+		// Free rectangles overlap : each one intersecting the new region is cut in up to four maximal parts
+		std::vector<Rect> parts;
+		for (auto it = m_free.begin(); it != m_free.end();)
+		{
+			const Rect free = *it;
+			if (!free.intersects(used))
+			{
+				++it;
+				continue;
+			}
+			if (used.x > free.x)
+				parts.push_back({free.x, free.y, used.x - free.x, free.h});
+			if (used.x + used.w < free.x + free.w)
+				parts.push_back({used.x + used.w, free.y, free.x + free.w - used.x - used.w, free.h});
+			if (used.y > free.y)
+				parts.push_back({free.x, free.y, free.w, used.y - free.y});
+			if (used.y + used.h < free.y + free.h)
+				parts.push_back({free.x, used.y + used.h, free.w, free.y + free.h - used.y - used.h});
+			it = m_free.erase(it);
+		}
+		m_free.insert(m_free.end(), parts.begin(), parts.end());
+	}
+	void TextureAtlas::release(const Rect& rect)
+	{
+		m_free.push_back(rect);
+		// Merge the rectangles sharing a whole edge, so that freed regions can take bigger images
+		for (bool merged = true; merged;)
+		{
+			merged = false;
+			for (size_t i = 0; i < m_free.size() && !merged; ++i)
+				for (size_t j = i + 1; j < m_free.size() && !merged; ++j)
+				{
+					Rect& a = m_free[i];
+					const Rect& b = m_free[j];
+					if (a.x == b.x && a.w == b.w && (a.y + a.h == b.y || b.y + b.h == a.y))
+					{
+						a.y = std::min(a.y, b.y);
+						a.h += b.h;
+						merged = true;
+					}
+					else if (a.y == b.y && a.h == b.h && (a.x + a.w == b.x || b.x + b.w == a.x))
+					{
+						a.x = std::min(a.x, b.x);
+						a.w += b.w;
+						merged = true;
+					}
+					if (merged)
+						m_free.erase(m_free.begin() + j);
+				}
+		}
+		prune();
+	}
+	void TextureAtlas::prune()
+	{
+		for (size_t i = 0; i < m_free.size(); ++i)
+			for (size_t j = i + 1; j < m_free.size();)
+			{
+				if (m_free[i].contains(m_free[j]))
+					m_free.erase(m_free.begin() + j);
+				else if (m_free[j].contains(m_free[i]))
+				{
+					m_free.erase(m_free.begin() + i);
+					j = i + 1;
+				}
+				else
+					++j;
+			}
+	}
+	const TextureAtlas::Slot& TextureAtlas::slot(Handle handle) const
+	{
+		if (handle >= m_slots.size() || !m_slots[handle].used)
+			throw std::runtime_error("gl::TextureAtlas invalid handle");
+		return m_slots[handle];
+	}
+}
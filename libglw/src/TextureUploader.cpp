@@ -0,0 +1,164 @@
+#include <libglw/TextureUploader.h>
+namespace gl
+{
+	TextureUploader::TextureUploader(GLsizeiptr buffer_size, size_t max_buffers) : m_bufferSize(buffer_size), m_maxBuffers(max_buffers)
+	{
+		if (buffer_size <= 0 || max_buffers == 0)
+			throw std::runtime_error("gl::TextureUploader invalid pool size");
+	}
+	TextureUploader::~TextureUploader()
+	{
+		for (auto& staging : m_staging)
+		{
+			if (staging->state == Staging::State::Mapped)
+			{
+				staging->mapping.unmap();
+				staging->buffer.unbind();
+			}
+			else if (staging->state == Staging::State::Copying)
+				staging->fence.wait();
+		}
+	}
+	TextureUploader::Ticket TextureUploader::stage(Texture& texture, GLenum format, GLenum type, glm::ivec2 size, glm::ivec2 offset, GLint level)
+	{
+		if (size.x <= 0 || size.y <= 0)
+			throw std::runtime_error("gl::TextureUploader::stage invalid size");
+		const GLsizeiptr pitch = rowPitch(format, type, size.x);
+		const GLsizeiptr bytes = pitch * size.y;
+		// Buffers whose copy is done can take this upload
+		retire(false);
+		Staging* staging = acquire(bytes);
+		if (!staging)
+		{
+			++m_stats.busy;
+			return nullptr;
+		}
+		// The fence has passed : the GPU doesn't read the buffer anymore
+		staging->mapping = staging->buffer.map_range(0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		staging->buffer.unbind();
+		Ticket upload = std::make_shared<Upload>();
+		upload->m_data = staging->mapping.data();
+		upload->m_size = bytes;
+		upload->m_rowPitch = pitch;
+		upload->m_texture = &texture;
+		upload->m_format = format;
+		upload->m_type = type;
+		upload->m_offset = offset;
+		upload->m_extent = size;
+		upload->m_level = level;
+		staging->upload = upload;
+		staging->state = Staging::State::Mapped;
+		return upload;
+	}
+	TextureUploader::Ticket TextureUploader::upload(Texture& texture, GLenum format, GLenum type, const void* pixels, glm::ivec2 size, glm::ivec2 offset, GLint level)
+	{
+		Ticket upload = stage(texture, format, type, size, offset, level);
+		if (!upload)
+			return nullptr;
+		const GLsizeiptr row = pixelSize(format, type) * size.x;
+		const unsigned char* source = static_cast<const unsigned char*>(pixels);
+		if (row == upload->rowPitch())
+			std::memcpy(upload->data(), source, upload->size());
+		else
+			for (int y = 0; y < size.y; ++y)
+				std::memcpy(upload->data() + y * upload->rowPitch(), source + y * row, row);
+		upload->submit();
+		return upload;
+	}
+	size_t TextureUploader::process()
+	{
+		size_t count = 0;
+		for (auto& staging : m_staging)
+			if (staging->state == Staging::State::Mapped && staging->upload->m_submitted.load(std::memory_order_acquire))
+			{
+				copy(*staging);
+				++count;
+			}
+		retire(false);
+		return count;
+	}
+	void TextureUploader::finish()
+	{
+		process();
+		retire(true);
+	}
+	size_t TextureUploader::pending() const
+	{
+		size_t count = 0;
+		for (const auto& staging : m_staging)
+			if (staging->state != Staging::State::Free)
+				++count;
+		return count;
+	}
+	TextureUploader::Staging* TextureUploader::acquire(GLsizeiptr size)
+	{
+		// The smallest free buffer big enough
+		Staging* best = nullptr;
+		Staging* smaller = nullptr;
+		for (auto& staging : m_staging)
+		{
+			if (staging->state != Staging::State::Free)
+				continue;
+			if (staging->buffer.capacity() >= size)
+			{
+				if (!best || staging->buffer.capacity() < best->buffer.capacity())
+					best = staging.get();
+			}
+			else
+				smaller = staging.get();
+		}
+		if (best)
+			return best;
+		if (m_staging.size() < m_maxBuffers)
+		{
+			m_staging.emplace_back(new Staging());
+			smaller = m_staging.back().get();
+		}
+		if (!smaller)
+			return nullptr;
+		if (smaller->buffer.id() == 0)
+			smaller->buffer.instantiate();
+		smaller->buffer.force_reserve(glm::max(size, m_bufferSize), GL_STREAM_DRAW);
+		smaller->buffer.unbind();
+		return smaller;
+	}
+	bool TextureUploader::retire(bool wait)
+	{
+		bool copying = false;
+		for (auto& staging : m_staging)
+		{
+			if (staging->state != Staging::State::Copying)
+				continue;
+			if (wait ? staging->fence.wait() : staging->fence.isSignaled())
+			{
+				staging->upload->m_done.store(true, std::memory_order_release);
+				staging->upload.reset();
+				staging->state = Staging::State::Free;
+			}
+			else
+				copying = true;
+		}
+		return copying;
+	}
+	void TextureUploader::copy(Staging& staging)
+	{
+		const Upload& upload = *staging.upload;
+		staging.mapping.unmap();
+		// Bound to GL_PIXEL_UNPACK_BUFFER, the pixel pointer is an offset in the buffer
+		staging.buffer.bind();
+		// Rows were laid out by rowPitch, whatever alignment the application uses
+		StateCache::Current().pixelStore(GL_UNPACK_ALIGNMENT, 4);
+		StateCache::Current().pixelStore(GL_UNPACK_ROW_LENGTH, 0);
+#if LIBGLW_WITH_DSA
+		glTextureSubImage2D(upload.m_texture->id(), upload.m_level, upload.m_offset.x, upload.m_offset.y, upload.m_extent.x, upload.m_extent.y, upload.m_format, upload.m_type, nullptr);
+#else
+		upload.m_texture->bind();
+		glTexSubImage2D(upload.m_texture->getTarget(), upload.m_level, upload.m_offset.x, upload.m_offset.y, upload.m_extent.x, upload.m_extent.y, upload.m_format, upload.m_type, nullptr);
+#endif
+		staging.buffer.unbind();
+		staging.fence.place();
+		staging.state = Staging::State::Copying;
+		++m_stats.uploads;
+		m_stats.bytes += upload.m_size;
+	}
+}
@@ -1,64 +1,81 @@
 #include <libglw/GLClass.h>
 #include <libglw/Shaders.h>
+#include <glm/gtc/type_ptr.hpp>
+#if LIBGLW_WITH_DSA
+#	define LIBGLW_UNIFORM(dsa, bound) dsa
+#else
+// glProgramUniform* doesn't bind the program, which would override a bound ProgramPipeline
+#	define LIBGLW_UNIFORM(dsa, bound) if (GLEW_VERSION_4_1 || GLEW_ARB_separate_shader_objects) { dsa; } else { StateCache::Current().useProgram(program); bound; }
+#endif
 namespace gl
 {
-	template <>
-	void Uniform<glm::mat4>::use(const gl::sl::Program& shader) const
-	{glUniformMatrix4fv(shader.getUniformLocation(name()), 1, GL_FALSE, reinterpret_cast<const GLfloat*>(instance()));}
-
-	template <>
-	void Uniform<glm::mat3>::use(const gl::sl::Program& shader) const
-	{glUniformMatrix3fv(shader.getUniformLocation(name()), 1, GL_FALSE, reinterpret_cast<const GLfloat*>(instance()));}
-
-	template <>
-	void Uniform<glm::mat2>::use(const gl::sl::Program& shader) const
-	{glUniformMatrix2fv(shader.getUniformLocation(name()), 1, GL_FALSE, reinterpret_cast<const GLfloat*>(instance()));}
-
-	template <>
-	void Uniform<glm::vec4>::use(const gl::sl::Program& shader) const
-	{glUniform4fv(shader.getUniformLocation(name()), 1, reinterpret_cast<const GLfloat*>(instance()));}
-
-	template <>
-	void Uniform<glm::vec3>::use(const gl::sl::Program& shader) const
-	{glUniform3fv(shader.getUniformLocation(name()), 1, reinterpret_cast<const GLfloat*>(instance()));}
-
-	template <>
-	void Uniform<glm::vec2>::use(const gl::sl::Program& shader) const
-	{glUniform2fv(shader.getUniformLocation(name()), 1, reinterpret_cast<const GLfloat*>(instance()));}
-
-	template <>
-	void Uniform<float>::use(const gl::sl::Program& shader) const
-	{glUniform1fv(shader.getUniformLocation(name()), 1, instance());}
-
-	template <>
-	void Uniform<glm::ivec4>::use(const gl::sl::Program& shader) const
-	{glUniform4iv(shader.getUniformLocation(name()), 1, reinterpret_cast<const GLint*>(instance()));}
-
-	template <>
-	void Uniform<glm::ivec3>::use(const gl::sl::Program& shader) const
-	{glUniform3iv(shader.getUniformLocation(name()), 1, reinterpret_cast<const GLint*>(instance()));}
-
-	template <>
-	void Uniform<glm::ivec2>::use(const gl::sl::Program& shader) const
-	{glUniform2iv(shader.getUniformLocation(name()), 1, reinterpret_cast<const GLint*>(instance()));}
-
-	template <>
-	void Uniform<int>::use(const gl::sl::Program& shader) const
-	{glUniform1iv(shader.getUniformLocation(name()), 1, reinterpret_cast<const GLint*>(instance()));}
-
-	template <>
-	void Uniform<glm::uvec4>::use(const gl::sl::Program& shader) const
-	{glUniform4uiv(shader.getUniformLocation(name()), 1, reinterpret_cast<const GLuint*>(instance()));}
-
-	template <>
-	void Uniform<glm::uvec3>::use(const gl::sl::Program& shader) const
-	{glUniform3uiv(shader.getUniformLocation(name()), 1, reinterpret_cast<const GLuint*>(instance()));}
-
-	template <>
-	void Uniform<glm::uvec2>::use(const gl::sl::Program& shader) const
-	{glUniform2uiv(shader.getUniformLocation(name()), 1, reinterpret_cast<const GLuint*>(instance()));}
-
-	template <>
-	void Uniform<uint32_t>::use(const gl::sl::Program& shader) const
-	{glUniform1uiv(shader.getUniformLocation(name()), 1, reinterpret_cast<const GLuint*>(instance()));}
-}
\ No newline at end of file
+	namespace detail
+	{
+		void upload(GLuint program, GLint location, const glm::mat4& value)
+		{LIBGLW_UNIFORM(glProgramUniformMatrix4fv(program, location, 1, GL_FALSE, glm::value_ptr(value)), glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value)));}
+
+		void upload(GLuint program, GLint location, const glm::mat3& value)
+		{LIBGLW_UNIFORM(glProgramUniformMatrix3fv(program, location, 1, GL_FALSE, glm::value_ptr(value)), glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(value)));}
+
+		void upload(GLuint program, GLint location, const glm::mat2& value)
+		{LIBGLW_UNIFORM(glProgramUniformMatrix2fv(program, location, 1, GL_FALSE, glm::value_ptr(value)), glUniformMatrix2fv(location, 1, GL_FALSE, glm::value_ptr(value)));}
+
+		void upload(GLuint program, GLint location, const glm::vec4& value)
+		{LIBGLW_UNIFORM(glProgramUniform4fv(program, location, 1, glm::value_ptr(value)), glUniform4fv(location, 1, glm::value_ptr(value)));}
+
+		void upload(GLuint program, GLint location, const glm::vec3& value)
+		{LIBGLW_UNIFORM(glProgramUniform3fv(program, location, 1, glm::value_ptr(value)), glUniform3fv(location, 1, glm::value_ptr(value)));}
+
+		void upload(GLuint program, GLint location, const glm::vec2& value)
+		{LIBGLW_UNIFORM(glProgramUniform2fv(program, location, 1, glm::value_ptr(value)), glUniform2fv(location, 1, glm::value_ptr(value)));}
+
+		void upload(GLuint program, GLint location, float value)
+		{LIBGLW_UNIFORM(glProgramUniform1f(program, location, value), glUniform1f(location, value));}
+
+		void upload(GLuint program, GLint location, const glm::ivec4& value)
+		{LIBGLW_UNIFORM(glProgramUniform4iv(program, location, 1, glm::value_ptr(value)), glUniform4iv(location, 1, glm::value_ptr(value)));}
+
+		void upload(GLuint program, GLint location, const glm::ivec3& value)
+		{LIBGLW_UNIFORM(glProgramUniform3iv(program, location, 1, glm::value_ptr(value)), glUniform3iv(location, 1, glm::value_ptr(value)));}
+
+		void upload(GLuint program, GLint location, const glm::ivec2& value)
+		{LIBGLW_UNIFORM(glProgramUniform2iv(program, location, 1, glm::value_ptr(value)), glUniform2iv(location, 1, glm::value_ptr(value)));}
+
+		void upload(GLuint program, GLint location, int value)
+		{LIBGLW_UNIFORM(glProgramUniform1i(program, location, value), glUniform1i(location, value));}
+
+		void upload(GLuint program, GLint location, const glm::uvec4& value)
+		{LIBGLW_UNIFORM(glProgramUniform4uiv(program, location, 1, glm::value_ptr(value)), glUniform4uiv(location, 1, glm::value_ptr(value)));}
+
+		void upload(GLuint program, GLint location, const glm::uvec3& value)
+		{LIBGLW_UNIFORM(glProgramUniform3uiv(program, location, 1, glm::value_ptr(value)), glUniform3uiv(location, 1, glm::value_ptr(value)));}
+
+		void upload(GLuint program, GLint location, const glm::uvec2& value)
+		{LIBGLW_UNIFORM(glProgramUniform2uiv(program, location, 1, glm::value_ptr(value)), glUniform2uiv(location, 1, glm::value_ptr(value)));}
+
+		void upload(GLuint program, GLint location, uint32_t value)
+		{LIBGLW_UNIFORM(glProgramUniform1ui(program, location, value), glUniform1ui(location, value));}
+	}
+
+	template <class Type>
+	void Uniform<Type>::use(const gl::sl::Program& shader) const
+	{
+		shader.setUniform(shader.getUniformLocation(uniformName()), *instance());
+	}
+
+	template class Uniform<glm::mat4>;
+	template class Uniform<glm::mat3>;
+	template class Uniform<glm::mat2>;
+	template class Uniform<glm::vec4>;
+	template class Uniform<glm::vec3>;
+	template class Uniform<glm::vec2>;
+	template class Uniform<float>;
+	template class Uniform<glm::ivec4>;
+	template class Uniform<glm::ivec3>;
+	template class Uniform<glm::ivec2>;
+	template class Uniform<int>;
+	template class Uniform<glm::uvec4>;
+	template class Uniform<glm::uvec3>;
+	template class Uniform<glm::uvec2>;
+	template class Uniform<uint32_t>;
+}